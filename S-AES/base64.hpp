@@ -1,7 +1,21 @@
+#include <algorithm>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <algorithm>
-#include <map>
+#include <array>
+#include <span>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+
+#include "instrument.hpp"
+#include "buffer-pool.hpp"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BASE64_AVX2 1
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
@@ -11,9 +25,16 @@ using namespace std;
 /**
  * @class Base64
  * @brief Provides static methods to encode and decode Base64 strings.
- * 
+ *
  * @details This class includes functions to convert a vector of bytes to a Base64-encoded string
  * and to decode a Base64 string back to its original byte form. The encoding follows the standard Base64 alphabet.
+ *
+ * The codec works on raw buffers written in place (encode / decode): a scalar path converts
+ * 3 bytes to 4 characters through table lookups, and on CPUs with AVX2 the bulk of the data goes
+ * through a vectorized path converting 24 bytes to 32 characters per step, with the characters
+ * translated by pshufb lookups (Muła and Lemire's method). Characters outside the alphabet are
+ * rejected by both paths. Decoding requires the canonical form: a multiple of 4 characters,
+ * the last group padded with one or two '=' when it encodes fewer than 3 bytes.
  */
 class Base64 {
 public:
@@ -21,111 +42,260 @@ public:
     static inline const string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
     /**
-     * @brief Converts a vector of bytes (integers 0-255) into a Base64-encoded string.
-     * 
-     * @details Each byte is first converted to its 8-bit binary representation and concatenated into a bit stream.
-     *  The bit stream is then split into 6-bit segments, each mapped to a Base64 character using the alphabet.
-     *  If the final segment is less than 6 bits, it is padded with zeros.
-     *  The output string is padded with '=' characters to ensure its length is a multiple of 4.
-     * 
-     * @param bytes A vector of integers representing bytes (values from 0 to 255).
-     * @return A Base64-encoded string.
+     * @brief Returns the number of characters encoding 'size' bytes (padding included).
+     */
+    static size_t encoded_length(size_t size) {
+        return (size + 2) / 3 * 4;
+    }
+
+    /**
+     * @brief Returns the number of bytes encoded by a Base64 string, without validating its characters.
+     *
+     * @throws invalid_argument if the length is not a multiple of 4 or the '=' padding is wrong.
      */
-    static string convert_to(const vector<int>& bytes) {
-        string output = "", stream = "";
+    static size_t decoded_length(const char* in, size_t size) {
+        size = strip_padding(in, size);
+        return size / 4 * 3 + (size % 4 == 0 ? 0 : size % 4 - 1);
+    }
 
-        for(auto &num : bytes) {
-            stream += get_binary_string(num);
+    static size_t decoded_length(const string& input) {
+        return decoded_length(input.data(), input.size());
+    }
+
+    /**
+     * @brief Encodes 'size' bytes into encoded_length(size) characters written to 'out'.
+     */
+    static void encode(const uint8_t* in, size_t size, char* out) {
+        Instrument::Timer timer(Instrument::BASE64_ENCODE);
+        size_t i = 0;
+#ifdef BASE64_AVX2
+        if(has_avx2()) i = encode_avx2(in, size, out);
+        out += i / 3 * 4;
+#endif
+        const char* digits = alphabet.data();
+        for(; i + 3 <= size; i += 3, out += 4){
+            uint32_t n = (uint32_t)in[i] << 16 | (uint32_t)in[i + 1] << 8 | in[i + 2];
+            out[0] = digits[n >> 18];
+            out[1] = digits[(n >> 12) & 63];
+            out[2] = digits[(n >> 6) & 63];
+            out[3] = digits[n & 63];
         }
+        if(i < size){
+            uint32_t n = (uint32_t)in[i] << 16 | (i + 1 < size ? (uint32_t)in[i + 1] << 8 : 0);
+            out[0] = digits[n >> 18];
+            out[1] = digits[(n >> 12) & 63];
+            out[2] = i + 1 < size ? digits[(n >> 6) & 63] : '=';
+            out[3] = '=';
+        }
+    }
 
-        while((int)stream.size() % 6 != 0) {
-            stream += "0";
+    /**
+     * @brief Decodes 'size' Base64 characters into 'out', which must hold decoded_length(in, size) bytes.
+     *
+     * @return The number of bytes written.
+     * @throws invalid_argument on a character outside the alphabet, a length that is not a
+     * multiple of 4 or wrong '=' padding.
+     */
+    static size_t decode(const char* in, size_t size, uint8_t* out) {
+        Instrument::Timer timer(Instrument::BASE64_DECODE);
+        size = strip_padding(in, size);
+        uint8_t* start = out;
+        size_t i = 0;
+#ifdef BASE64_AVX2
+        if(has_avx2()){
+            i = decode_avx2(in, size, out);
+            out += i / 4 * 3;
         }
+#endif
+        for(; i + 4 <= size; i += 4, out += 3){
+            int32_t n = value(in[i]) << 18 | value(in[i + 1]) << 12 | value(in[i + 2]) << 6 | value(in[i + 3]);
+            if(n < 0) throw invalid_argument("invalid base64 character");
+            out[0] = (uint8_t)(n >> 16);
+            out[1] = (uint8_t)(n >> 8);
+            out[2] = (uint8_t)n;
+        }
+        if(i < size){
+            int32_t n = value(in[i]) << 18 | value(in[i + 1]) << 12 | (i + 2 < size ? value(in[i + 2]) << 6 : 0);
+            if(n < 0) throw invalid_argument("invalid base64 character");
+            *out++ = (uint8_t)(n >> 16);
+            if(i + 2 < size) *out++ = (uint8_t)(n >> 8);
+        }
+        return (size_t)(out - start);
+    }
 
-        for(int i = 0; i < (int)stream.size(); i += 6) {
-            string segment = stream.substr(i, 6);
-            int index = stoi(segment, nullptr, 2);
-            output += alphabet[index];
+    /**
+     * @brief Converts a sequence of bytes (integers 0-255) into a Base64-encoded string.
+     *
+     * @details Every group of 3 bytes gives 4 characters of the alphabet; the output string is
+     *  padded with '=' characters to ensure its length is a multiple of 4.
+     *
+     * @param bytes A sequence of bytes (vector<int> with values 0 to 255, vector<uint8_t>, span...).
+     * @return A Base64-encoded string.
+     */
+    template<class Bytes>
+    static string convert_to(const Bytes& bytes) {
+        if constexpr (is_convertible_v<const Bytes&, span<const uint8_t>>) {
+            span<const uint8_t> data = bytes;
+            Instrument::count(Instrument::ALLOCATIONS);
+            string output(encoded_length(data.size()), '\0');
+            encode(data.data(), data.size(), output.data());
+            return output;
+        } else {
+            BufferPool::Buffer data(bytes.size());
+            copy(bytes.begin(), bytes.end(), data.data());
+            return convert_to(span<const uint8_t>(data));
         }
+    }
 
-        int padding = (4 - ((int)output.size() % 4)) % 4;
-        
-        output += string(padding, '=');
-        
-        return output;
+    /**
+     * @brief Encodes bytes into 'output', reusing its capacity (no allocation once it is large enough).
+     */
+    static void convert_to(span<const uint8_t> bytes, string& output) {
+        BufferPool::resize(output, encoded_length(bytes.size()));
+        encode(bytes.data(), bytes.size(), output.data());
+    }
+
+    /**
+     * @brief Decodes a Base64-encoded string into a vector of bytes.
+     *
+     * @throws invalid_argument on a character outside the alphabet or an invalid length.
+     */
+    static vector<uint8_t> decode(const string& input) {
+        vector<uint8_t> bytes;
+        decode(input, bytes);
+        return bytes;
+    }
+
+    /**
+     * @brief Decodes a Base64 string into 'output' (a string or byte vector), reusing its capacity.
+     *
+     * @throws invalid_argument as decode(const string&).
+     */
+    template<class Output>
+    static void decode(string_view input, Output& output) {
+        BufferPool::resize(output, decoded_length(input.data(), input.size()));
+        decode(input.data(), input.size(), (uint8_t*)output.data());
     }
 
-    /*  Decodes a Base64-encoded string back into a vector of bytes (integers 0-255).
-        Each Base64 character is mapped back to its 6-bit binary value using the alphabet.
-        The resulting bit stream is concatenated and split into 8-bit segments to recover the original bytes.
-        Any '=' padding characters at the end of the input are removed before decoding.
-    */
     /**
      * @brief Decodes a Base64-encoded string into a vector of bytes (integers 0-255).
-     * 
-     * @details Each Base64 character is mapped back to its 6-bit binary value using the alphabet.
-     *  The resulting bit stream is concatenated and split into 8-bit segments to recover the original bytes.
-     *  Any '=' padding characters at the end of the input are removed before decoding.
-     * 
+     *
      * @param input The Base64-encoded string to decode.
      * @return A vector of integers representing the decoded bytes.
+     * @throws invalid_argument on a character outside the alphabet or an invalid length.
      */
-    static vector<int> convert_from(string input) {
-        map<char, int> charPos;
+    static vector<int> convert_from(const string& input) {
+        vector<uint8_t> bytes = decode(input);
+        return vector<int>(bytes.begin(), bytes.end());
+    }
 
-        for(int i = 0; i < (int)alphabet.size(); i++) {
-            charPos[alphabet[i]] = i;
-        }
+private:
 
-        string stream = "";
-        vector<int> bytes;
-        
-        // Remove padding
-        while (!input.empty() && input.back() == '=') {
-            input.pop_back();
-        }
+    // Value of every character, -1 outside the alphabet
+    static constexpr array<int8_t, 256> VALUES = [] {
+        array<int8_t, 256> values{};
+        const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for(auto &v : values) v = -1;
+        for(int i=0; i < 64; i++) values[(uint8_t)digits[i]] = (int8_t)i;
+        return values;
+    }();
 
-        for (auto &c : input) {
-            int idx = charPos[c];
-            string bits = "";
-        
-            for (int i = 5; i >= 0; --i) {
-                bits += ((idx >> i) & 1) ? '1' : '0';
-            }
-        
-            stream += bits;
-        }
+    static int32_t value(char c) {
+        return VALUES[(uint8_t)c];
+    }
 
-        // Split into bytes (8 bits)
-        for (int i = 0; i + 8 <= (int)stream.size(); i += 8) {
-            string byte_str = stream.substr(i, 8);
-            int byte = stoi(byte_str, nullptr, 2);
-            bytes.push_back(byte);
-        }
+    // Returns the number of characters before the padding, checking the canonical length and padding
+    static size_t strip_padding(const char* in, size_t size) {
+        if(size % 4 != 0) throw invalid_argument("invalid base64 length (" + to_string(size) + " characters, not a multiple of 4)");
+        size_t data = size;
+        while(data > 0 && in[data - 1] == '=') data--;
+        if(data % 4 == 1) throw invalid_argument("invalid base64 length (the last group has a single character before the padding)");
+        if(size - data != (4 - data % 4) % 4) throw invalid_argument("invalid base64 padding");
+        return data;
+    }
 
-        return bytes;
+#ifdef BASE64_AVX2
+    static bool has_avx2() {
+        static const bool avx2 = [] {
+            __builtin_cpu_init();
+            return (bool)__builtin_cpu_supports("avx2");
+        }();
+        return avx2;
     }
-    
-    /**
-     * @brief Converts an integer to its 8-bit binary string representation.
-     * 
-     * @param n The integer to convert (expected in range 0-255).
-     * @return An 8-character string with the binary representation of the number.
-     */
-    static string get_binary_string(int n) {
-        string result = "";
 
-        while(n > 0) {
-            result = to_string(n % 2) + result;
-            n /= 2;
+    /*  Encodes 24 bytes into 32 characters per step, as long as the 16-byte loads stay inside 'in'.
+        Each 128-bit lane takes 12 bytes, spread so that every 32-bit word holds the 3 bytes of one
+        group; multiplies move the four 6-bit fields to the low bits of four bytes, and a pshufb
+        lookup gives the offset that turns each 6-bit value into its character.
+        Returns the number of input bytes consumed.
+    */
+    __attribute__((target("avx2")))
+    static size_t encode_avx2(const uint8_t* in, size_t size, char* out) {
+        const __m256i spread = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                                1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+        const __m256i offsets = _mm256_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0,
+                                                 65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+        size_t i = 0;
+        for(; i + 28 <= size; i += 24, out += 32){
+            __m256i v = _mm256_setr_m128i(_mm_loadu_si128((const __m128i*)(in + i)),
+                                          _mm_loadu_si128((const __m128i*)(in + i + 12)));
+            v = _mm256_shuffle_epi8(v, spread);
+            __m256i ac = _mm256_mulhi_epu16(_mm256_and_si256(v, _mm256_set1_epi32(0x0FC0FC00)), _mm256_set1_epi32(0x04000040));
+            __m256i bd = _mm256_mullo_epi16(_mm256_and_si256(v, _mm256_set1_epi32(0x003F03F0)), _mm256_set1_epi32(0x01000010));
+            __m256i indices = _mm256_or_si256(ac, bd);
+
+            // 0-25 -> 0, 26-51 -> 1, 52-61 -> 2-11, 62 -> 12, 63 -> 13
+            __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+            range = _mm256_sub_epi8(range, _mm256_cmpgt_epi8(indices, _mm256_set1_epi8(25)));
+            __m256i chars = _mm256_add_epi8(indices, _mm256_shuffle_epi8(offsets, range));
+            _mm256_storeu_si256((__m256i*)out, chars);
+        }
+        return i;
+    }
+
+    /*  Decodes 32 characters into 24 bytes per step, leaving at least the last 16 characters (and
+        the padding) to the scalar code so the 32-byte stores stay inside 'out'.
+        Characters are validated and translated with pshufb lookups on their high and low nibbles,
+        then the 6-bit values are packed with multiply-adds. Returns the number of characters consumed.
+    */
+    __attribute__((target("avx2")))
+    static size_t decode_avx2(const char* in, size_t size, uint8_t* out) {
+        const __m256i lut_lo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                                0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+                                                0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                                0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+        const __m256i lut_hi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                                0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                                0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                                0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+        const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                                  0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+        const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                              2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+        const __m256i mask_2f = _mm256_set1_epi8(0x2F);
+        size_t i = 0;
+        for(; i + 48 <= size; i += 32, out += 24){
+            __m256i chars = _mm256_loadu_si256((const __m256i*)(in + i));
+            __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(chars, 4), mask_2f);
+            __m256i lo_nibbles = _mm256_and_si256(chars, mask_2f);
+            __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+            __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+            if(!_mm256_testz_si256(lo, hi)) throw invalid_argument("invalid base64 character");
+
+            __m256i is_slash = _mm256_cmpeq_epi8(chars, mask_2f);
+            __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(is_slash, hi_nibbles));
+            __m256i values = _mm256_add_epi8(chars, roll);
+
+            __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+            __m256i words = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+            __m256i bytes = _mm256_shuffle_epi8(words, pack);
+            bytes = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+            _mm256_storeu_si256((__m256i*)out, bytes);
         }
-        
-        while((int)result.size() < 8)
-            result = "0" + result;
-        
-        return result;
+        return i;
     }
+#endif
 
 };
 
-#endif
\ No newline at end of file
+#endif
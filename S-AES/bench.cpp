@@ -0,0 +1,533 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <x86intrin.h>
+#define BENCH_RDTSC 1
+#endif
+
+#include "s-aes.hpp"
+#include "fast-saes.hpp"
+#include "codebook.hpp"
+#include "bitslice.hpp"
+#include "ecb.hpp"
+#include "cbc.hpp"
+#include "cfb.hpp"
+#include "ofb.hpp"
+#include "ctr.hpp"
+#include "hex.hpp"
+#include "key-search.hpp"
+#include "meet-in-the-middle.hpp"
+
+using namespace std;
+
+// Accumulated into the result so the compiler cannot drop the benchmarked work
+volatile uint32_t sink;
+
+/*  Runs 'blocks' block operations through 'op' and returns the average time per block in ns.
+    Every block depends on the previous output so the measured time is latency, not just throughput.
+*/
+double ns_per_block(const function<int(int)>& op, int blocks){
+    auto start = chrono::steady_clock::now();
+    int state = 0x1234;
+    for(int i=0; i < blocks; i++) state = op(state ^ i) & 0xFFFF;
+    auto end = chrono::steady_clock::now();
+    sink = state;
+    return chrono::duration<double, nano>(end - start).count() / blocks;
+}
+
+void report(const char* name, double enc, double dec, double baseline){
+    printf("%-28s %10.2f %10.2f %9.1fx\n", name, enc, dec, baseline / enc);
+}
+
+/*  Settings of the size/engine matrix, set from the command line.
+*/
+struct Config {
+    vector<size_t> sizes = {16, 4096, 1 << 20, 1 << 28};
+    string messages = "messages";  // Directory of the hex corpus (random data is used for missing files)
+    double warmup = 0.05;          // Seconds of warmup per case
+    double budget = 0.5;           // Target seconds of measurement per case
+    size_t min_iterations = 5, max_iterations = 1000;
+    int threads = 1;
+    bool latency = true;
+    string csv, json;
+};
+
+struct Stats {
+    string engine, operation;
+    size_t bytes, iterations;
+    double median_ns, mean_ns, p99_ns, stddev_ns, min_ns;
+    double mb_per_s, cycles_per_byte;
+};
+
+static uint64_t cycles(){
+#ifdef BENCH_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/*  Times 'run' (one pass over 'bytes' bytes): warmup first, then enough iterations to fill the
+    time budget (within the iteration bounds), each one timed separately.
+*/
+Stats measure(const function<void()>& run, size_t bytes, const Config& config){
+    auto now = [] { return chrono::steady_clock::now(); };
+    auto warmup_start = now();
+    size_t warmup_runs = 0;
+    do {
+        run();
+        warmup_runs++;
+    } while(chrono::duration<double>(now() - warmup_start).count() < config.warmup && warmup_runs < config.max_iterations);
+    double estimate = chrono::duration<double>(now() - warmup_start).count() / warmup_runs;
+
+    size_t iterations = (size_t)(config.budget / max(estimate, 1e-9));
+    iterations = clamp(iterations, config.min_iterations, config.max_iterations);
+    vector<double> times(iterations), ticks(iterations);
+    for(size_t i=0; i < iterations; i++){
+        auto start = now();
+        uint64_t start_cycles = cycles();
+        run();
+        ticks[i] = (double)(cycles() - start_cycles);
+        times[i] = chrono::duration<double, nano>(now() - start).count();
+    }
+
+    Stats stats{};
+    stats.bytes = bytes;
+    stats.iterations = iterations;
+    double sum = 0, squares = 0;
+    for(double t : times) sum += t;
+    stats.mean_ns = sum / iterations;
+    for(double t : times) squares += (t - stats.mean_ns) * (t - stats.mean_ns);
+    stats.stddev_ns = sqrt(squares / iterations);
+
+    sort(times.begin(), times.end());
+    sort(ticks.begin(), ticks.end());
+    stats.min_ns = times[0];
+    stats.median_ns = times[iterations / 2];
+    stats.p99_ns = times[(size_t)ceil(0.99 * iterations) - 1];
+    stats.mb_per_s = bytes / (stats.median_ns * 1e-9) / 1e6;
+    stats.cycles_per_byte = ticks[iterations / 2] / bytes;
+    return stats;
+}
+
+/*  An engine or mode under test: encrypt / decrypt process 'size' bytes in place.
+*/
+struct Case {
+    string name;
+    function<void(uint8_t*, size_t)> encrypt, decrypt;
+    size_t max_size = SIZE_MAX;    // Slow engines are skipped above this size
+};
+
+// Message of 'size' bytes: the corpus file when present, random bytes otherwise
+vector<uint8_t> load_message(size_t size, const Config& config){
+    ifstream file(config.messages + "/hex/" + to_string(size) + "_bytes");
+    if(file){
+        string text;
+        getline(file, text);
+        try {
+            vector<uint8_t> bytes = Hex::decode(text);
+            if(bytes.size() == size) return bytes;
+        } catch(const invalid_argument&) {}
+    }
+    vector<uint8_t> bytes(size);
+    mt19937_64 rng(size);
+    for(auto &b : bytes) b = (uint8_t)rng();
+    return bytes;
+}
+
+vector<Case> build_cases(int key, const Config& config){
+    static SAES saes(key);
+    static uint16_t round_keys[3];
+    FastSAES::expand_key(key, round_keys);
+    static Codebook codebook(key);
+    static ECB ecb(key);
+    static CBC cbc(key, 0x1234, false);
+    static CFB cfb(key, 0x1234);
+    static OFB ofb(key, 0x1234), ofb_cached(key, 0x1234, true);
+    static vector<shared_ptr<CTR>> ctrs;    // Indexed by nonce bits: 128 KiB (0 bits) down to 512 B (8 bits) of keystream
+    if(ctrs.empty()) for(int bits=0; bits <= 8; bits++) ctrs.push_back(make_shared<CTR>(key, 0, bits));
+    ecb.set_threads(config.threads);
+    cbc.set_threads(config.threads);
+    cfb.set_threads(config.threads);
+    for(auto& ctr : ctrs) ctr->set_threads(config.threads);
+
+    auto block_loop = [](auto op) {
+        return [op](uint8_t* data, size_t size) {
+            for(size_t i=0; i + 1 < size; i += 2){
+                uint16_t block = op((uint16_t)((data[i] << 8) | data[i + 1]));
+                data[i] = block >> 8;
+                data[i + 1] = block & 0xFF;
+            }
+        };
+    };
+    auto span_of = [](uint8_t* data, size_t size) { return span<uint8_t>(data, size); };
+
+    vector<Case> cases;
+    cases.push_back({"Reference", block_loop([](uint16_t n) { return (uint16_t)saes.encrypt_reference(n); }),
+                     block_loop([](uint16_t n) { return (uint16_t)saes.decrypt_reference(n); }), 1 << 20});
+    cases.push_back({"FastSAES", block_loop([](uint16_t n) { return FastSAES::encrypt(n, round_keys); }),
+                     block_loop([](uint16_t n) { return FastSAES::decrypt(n, round_keys); })});
+    cases.push_back({"Codebook", block_loop([](uint16_t n) { return codebook.encrypt(n); }),
+                     block_loop([](uint16_t n) { return codebook.decrypt(n); })});
+    for(int isa=BitslicedSAES::SCALAR; isa <= BitslicedSAES::best_isa(); isa++){
+        auto engine = make_shared<BitslicedSAES>(key, (BitslicedSAES::ISA)isa);
+        cases.push_back({string("Bitsliced ") + BitslicedSAES::isa_name(engine->isa),
+                         [engine](uint8_t* data, size_t size) { engine->encrypt(data, data, size / 2); },
+                         [engine](uint8_t* data, size_t size) { engine->decrypt(data, data, size / 2); }});
+    }
+    cases.push_back({"ECB", [=](uint8_t* d, size_t n) { ecb.encrypt(span_of(d, n), span_of(d, n)); },
+                     [=](uint8_t* d, size_t n) { ecb.decrypt(span_of(d, n), span_of(d, n)); }});
+    cases.push_back({"CBC", [=](uint8_t* d, size_t n) { cbc.reset(cbc.iv); cbc.encrypt(span_of(d, n), span_of(d, n)); },
+                     [=](uint8_t* d, size_t n) { cbc.reset(cbc.iv); cbc.decrypt(span_of(d, n), span_of(d, n)); }});
+    cases.push_back({"CFB", [=](uint8_t* d, size_t n) { cfb.reset(cfb.iv); cfb.encrypt(span_of(d, n), span_of(d, n)); },
+                     [=](uint8_t* d, size_t n) { cfb.reset(cfb.iv); cfb.decrypt(span_of(d, n), span_of(d, n)); }});
+    cases.push_back({"OFB", [=](uint8_t* d, size_t n) { ofb.reset(); ofb.encrypt(span_of(d, n), span_of(d, n)); },
+                     [=](uint8_t* d, size_t n) { ofb.reset(); ofb.decrypt(span_of(d, n), span_of(d, n)); }});
+    cases.push_back({"OFB cached", [=](uint8_t* d, size_t n) { ofb_cached.reset(); ofb_cached.encrypt(span_of(d, n), span_of(d, n)); },
+                     [=](uint8_t* d, size_t n) { ofb_cached.reset(); ofb_cached.decrypt(span_of(d, n), span_of(d, n)); }});
+    // Every iteration generates its keystream, as a message does: with the nonce size it needs
+    // (nonce_bits_for), and one generation per 128 KiB segment beyond what a single key covers
+    auto ctr_segments = [=](uint8_t* d, size_t n) {
+        CTR& ctr = *ctrs[CTR::nonce_bits_for(min<uint64_t>(n, 1 << 17))];
+        for(size_t offset=0, segment=0; offset < n; offset += ctr.period(), segment++){
+            ctr.rekey((key + (int)segment) & 0xFFFF, 0);
+            size_t length = min<size_t>(n - offset, ctr.period());
+            ctr.crypt_at(span_of(d + offset, length), span_of(d + offset, length), 0);
+        }
+    };
+    cases.push_back({"CTR", ctr_segments, ctr_segments});
+    return cases;
+}
+
+void write_csv(const string& path, const vector<Stats>& results){
+    ofstream out(path);
+    out << "engine,operation,bytes,iterations,median_ns,mean_ns,p99_ns,stddev_ns,min_ns,mb_per_s,cycles_per_byte\n";
+    for(auto &r : results){
+        out << r.engine << ',' << r.operation << ',' << r.bytes << ',' << r.iterations << ',' << r.median_ns << ','
+            << r.mean_ns << ',' << r.p99_ns << ',' << r.stddev_ns << ',' << r.min_ns << ',' << r.mb_per_s << ','
+            << r.cycles_per_byte << '\n';
+    }
+}
+
+void write_json(const string& path, const vector<Stats>& results, int key, const Config& config){
+    ofstream out(path);
+    out << "{\n  \"key\": \"" << hex << key << dec << "\",\n  \"threads\": " << config.threads
+        << ",\n  \"best_isa\": \"" << BitslicedSAES::isa_name(BitslicedSAES::best_isa()) << "\",\n  \"results\": [\n";
+    for(size_t i=0; i < results.size(); i++){
+        auto &r = results[i];
+        out << "    {\"engine\": \"" << r.engine << "\", \"operation\": \"" << r.operation << "\", \"bytes\": " << r.bytes
+            << ", \"iterations\": " << r.iterations << ", \"median_ns\": " << r.median_ns << ", \"mean_ns\": " << r.mean_ns
+            << ", \"p99_ns\": " << r.p99_ns << ", \"stddev_ns\": " << r.stddev_ns << ", \"min_ns\": " << r.min_ns
+            << ", \"mb_per_s\": " << r.mb_per_s << ", \"cycles_per_byte\": " << r.cycles_per_byte << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+void usage(){
+    printf("usage: saes_bench [--sizes 16,4096,...] [--messages DIR] [--iterations MIN,MAX] [--budget SECONDS]\n"
+           "                  [--warmup SECONDS] [--threads N] [--no-latency] [--csv FILE] [--json FILE]\n");
+}
+
+Config parse(int argc, char** argv){
+    Config config;
+    for(int i=1; i < argc; i++){
+        string option = argv[i];
+        auto value = [&]() -> string {
+            if(i + 1 >= argc) throw invalid_argument("missing value for " + option);
+            return argv[++i];
+        };
+        if(option == "--sizes"){
+            config.sizes.clear();
+            string list = value();
+            for(size_t start=0; start <= list.size(); ){
+                size_t end = min(list.find(',', start), list.size());
+                config.sizes.push_back(stoull(list.substr(start, end - start)));
+                start = end + 1;
+            }
+        }
+        else if(option == "--messages") config.messages = value();
+        else if(option == "--iterations"){
+            string range = value();
+            size_t comma = range.find(',');
+            config.min_iterations = max<size_t>(1, stoull(range.substr(0, comma)));
+            config.max_iterations = comma == string::npos ? config.min_iterations : stoull(range.substr(comma + 1));
+            config.max_iterations = max(config.max_iterations, config.min_iterations);
+        }
+        else if(option == "--budget") config.budget = stod(value());
+        else if(option == "--warmup") config.warmup = stod(value());
+        else if(option == "--threads") config.threads = stoi(value());
+        else if(option == "--no-latency") config.latency = false;
+        else if(option == "--csv") config.csv = value();
+        else if(option == "--json") config.json = value();
+        else throw invalid_argument("unknown option: " + option);
+    }
+    return config;
+}
+
+void latency_table(int key){
+    const int reference_blocks = 1 << 16, fast_blocks = 1 << 24;
+
+    SAES saes(key);
+    uint16_t round_keys[3];
+    FastSAES::expand_key(key, round_keys);
+    Codebook codebook(key);
+
+    printf("S-AES single-block latency (key %04X), ns/block\n\n", key);
+    printf("%-28s %10s %10s %10s\n", "Path", "Encrypt", "Decrypt", "Speedup");
+
+    double ref_enc = ns_per_block([&](int n){ return saes.encrypt_reference(n); }, reference_blocks);
+    double ref_dec = ns_per_block([&](int n){ return saes.decrypt_reference(n); }, reference_blocks);
+    report("Reference (nibble matrix)", ref_enc, ref_dec, ref_enc);
+
+    double saes_enc = ns_per_block([&](int n){ return saes.encrypt(n); }, fast_blocks);
+    double saes_dec = ns_per_block([&](int n){ return saes.decrypt(n); }, fast_blocks);
+    report("SAES (ECB, fast path)", saes_enc, saes_dec, ref_enc);
+
+    double fast_enc = ns_per_block([&](int n){ return FastSAES::encrypt(n, round_keys); }, fast_blocks);
+    double fast_dec = ns_per_block([&](int n){ return FastSAES::decrypt(n, round_keys); }, fast_blocks);
+    report("FastSAES (packed state)", fast_enc, fast_dec, ref_enc);
+
+    double cb_enc = ns_per_block([&](int n){ return codebook.encrypt(n); }, fast_blocks);
+    double cb_dec = ns_per_block([&](int n){ return codebook.decrypt(n); }, fast_blocks);
+    report("Codebook (table lookup)", cb_enc, cb_dec, ref_enc);
+    printf("\n");
+}
+
+// Blocks encrypted each under its own key: one FastSAES key schedule per block vs the multi-key kernel
+void multi_key_table(){
+    const size_t count = 1 << 16;
+    vector<uint16_t> keys(count), blocks(count), out(count);
+    mt19937 rng(7);
+    for(size_t i=0; i < count; i++){
+        keys[i] = (uint16_t)rng();
+        blocks[i] = (uint16_t)rng();
+    }
+    auto nanoseconds = [&](const function<void()>& run, int runs) {
+        auto start = chrono::steady_clock::now();
+        for(int i=0; i < runs; i++) run();
+        sink = out[0];
+        return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / runs / count;
+    };
+
+    printf("One key per block (%zu keys), ns/block\n\n", count);
+    double single = nanoseconds([&] {
+        for(size_t i=0; i < count; i++){
+            uint16_t round_keys[3];
+            FastSAES::expand_key(keys[i], round_keys);
+            out[i] = FastSAES::encrypt(blocks[i], round_keys);
+        }
+    }, 20);
+    printf("%-28s %10.2f\n", "FastSAES (schedule per key)", single);
+    for(int isa=BitslicedSAES::SCALAR; isa <= BitslicedSAES::best_isa(); isa++){
+        double time = nanoseconds([&] {
+            BitslicedSAES::encrypt_many(keys.data(), blocks.data(), out.data(), count, (BitslicedSAES::ISA)isa);
+        }, 50);
+        printf("%-28s %10.2f %9.1fx\n", (string("Bitsliced ") + BitslicedSAES::isa_name((BitslicedSAES::ISA)isa)).c_str(),
+               time, single / time);
+    }
+    printf("\n");
+}
+
+// Time of a known-plaintext search over the whole key space, for the table-driven path and each ISA
+void key_search_table(int key){
+    uint16_t round_keys[3];
+    FastSAES::expand_key(key, round_keys);
+    vector<KnownPair> pairs = {{0x6F6B, 0}, {0x1234, 0}};
+    for(auto &pair : pairs) pair.ciphertext = FastSAES::encrypt(pair.plaintext, round_keys);
+
+    auto microseconds = [](const function<size_t()>& search, int runs) {
+        auto start = chrono::steady_clock::now();
+        for(int i=0; i < runs; i++) sink = (uint32_t)search();
+        return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / runs;
+    };
+
+    printf("Known-plaintext key search (65,536 keys, %zu pairs), us/search\n\n", pairs.size());
+    double table = microseconds([&] {
+        size_t found = 0;
+        for(uint32_t k=0; k < KeySearch::KEYS; k++){
+            uint16_t keys[3];
+            FastSAES::expand_key((uint16_t)k, keys);
+            bool match = true;
+            for(auto &pair : pairs) match = match && FastSAES::encrypt(pair.plaintext, keys) == pair.ciphertext;
+            found += match;
+        }
+        return found;
+    }, 20);
+    printf("%-28s %10.1f\n", "FastSAES (one key at a time)", table);
+    for(int isa=BitslicedSAES::SCALAR; isa <= BitslicedSAES::best_isa(); isa++){
+        KeySearch search((BitslicedSAES::ISA)isa);
+        double time = microseconds([&] { return search.search(pairs).size(); }, 200);
+        printf("%-28s %10.1f %9.1fx\n", (string("Bitsliced ") + BitslicedSAES::isa_name((BitslicedSAES::ISA)isa)).c_str(),
+               time, table / time);
+    }
+    printf("\n");
+
+    // Double S-AES under (key, ~key): best of a few runs of each phase
+    DoubleSAES cipher(key, ~key & 0xFFFF);
+    for(auto &pair : pairs) pair.ciphertext = (uint16_t)cipher.encrypt(pair.plaintext);
+    MeetInTheMiddle attack;
+    MeetInTheMiddle::Report best;
+    for(int run=0; run < 10; run++){
+        sink = (uint32_t)attack.attack(pairs).size();
+        const MeetInTheMiddle::Report& report = attack.last_report();
+        if(run == 0 || report.forward_ms + report.backward_ms < best.forward_ms + best.backward_ms) best = report;
+    }
+    printf("Meet-in-the-middle on double S-AES (%zu pairs): table %zu KiB, %zu candidates, "
+           "forward %.2f ms, backward %.2f ms\n\n", pairs.size(), best.table_bytes / 1024, best.candidates,
+           best.forward_ms, best.backward_ms);
+}
+
+// Known-answer check of every bitsliced kernel against FastSAES: the round trip of the timed cases
+// cannot catch a kernel that is wrong but still invertible (S-box circuit, transpose, key expansion)
+bool check_kernels(){
+    mt19937 rng(0x5AE5);
+    const vector<uint16_t> keys = {0x0000, 0xFFFF, 0x3A94, (uint16_t)rng(), (uint16_t)rng()};
+    bool correct = true;
+    auto mismatch = [&](const char* what, BitslicedSAES::ISA isa, size_t count, const char* unit = "blocks") {
+        fprintf(stderr, "saes_bench: bitsliced %s (%s, %zu %s) differs from FastSAES\n",
+                what, BitslicedSAES::isa_name(isa), count, unit);
+        correct = false;
+    };
+
+    for(int i=BitslicedSAES::SCALAR; i <= BitslicedSAES::best_isa(); i++){
+        BitslicedSAES::ISA isa = (BitslicedSAES::ISA)i;
+        size_t batch = BitslicedSAES::batch_blocks(isa);
+
+        // Single key, partial and odd batches, then the whole block space
+        for(uint16_t key : keys){
+            uint16_t round_keys[3];
+            FastSAES::expand_key(key, round_keys);
+            BitslicedSAES engine(key, isa);
+            for(size_t count : {(size_t)1, (size_t)7, batch - 1, batch + 1, 3 * batch + 5, (size_t)1 << 16}){
+                vector<uint8_t> in(2 * count), enc(2 * count), dec(2 * count);
+                for(size_t b=0; b < count; b++){
+                    uint16_t block = count == 1 << 16 ? (uint16_t)b : (uint16_t)rng();
+                    in[2 * b] = block >> 8;
+                    in[2 * b + 1] = block & 0xFF;
+                }
+                engine.encrypt(in.data(), enc.data(), count);
+                engine.decrypt(in.data(), dec.data(), count);
+                bool enc_ok = true, dec_ok = true;
+                for(size_t b=0; b < count; b++){
+                    uint16_t block = (uint16_t)((in[2 * b] << 8) | in[2 * b + 1]);
+                    enc_ok = enc_ok && ((enc[2 * b] << 8) | enc[2 * b + 1]) == FastSAES::encrypt(block, round_keys);
+                    dec_ok = dec_ok && ((dec[2 * b] << 8) | dec[2 * b + 1]) == FastSAES::decrypt(block, round_keys);
+                }
+                if(!enc_ok) mismatch("encryption", isa, count);
+                if(!dec_ok) mismatch("decryption", isa, count);
+            }
+        }
+
+        // One key per lane
+        for(size_t count : {(size_t)1, batch - 1, 2 * batch + 3, (size_t)4099}){
+            vector<uint16_t> many_keys(count), blocks(count), enc(count), dec(count);
+            for(size_t b=0; b < count; b++){
+                many_keys[b] = (uint16_t)rng();
+                blocks[b] = (uint16_t)rng();
+            }
+            BitslicedSAES::encrypt_many(many_keys.data(), blocks.data(), enc.data(), count, isa);
+            BitslicedSAES::decrypt_many(many_keys.data(), blocks.data(), dec.data(), count, isa);
+            bool enc_ok = true, dec_ok = true;
+            for(size_t b=0; b < count; b++){
+                uint16_t round_keys[3];
+                FastSAES::expand_key(many_keys[b], round_keys);
+                enc_ok = enc_ok && enc[b] == FastSAES::encrypt(blocks[b], round_keys);
+                dec_ok = dec_ok && dec[b] == FastSAES::decrypt(blocks[b], round_keys);
+            }
+            if(!enc_ok) mismatch("encrypt_many", isa, count);
+            if(!dec_ok) mismatch("decrypt_many", isa, count);
+        }
+
+        // Key search over the whole key space: exactly the keys FastSAES finds consistent
+        for(uint16_t key : keys){
+            uint16_t round_keys[3];
+            FastSAES::expand_key(key, round_keys);
+            uint16_t plaintexts[2] = {(uint16_t)rng(), (uint16_t)rng()}, ciphertexts[2];
+            for(int p=0; p < 2; p++) ciphertexts[p] = FastSAES::encrypt(plaintexts[p], round_keys);
+            vector<uint16_t> expected, found;
+            for(uint32_t k=0; k < 1 << 16; k++){
+                FastSAES::expand_key((uint16_t)k, round_keys);
+                if(FastSAES::encrypt(plaintexts[0], round_keys) == ciphertexts[0]
+                   && FastSAES::encrypt(plaintexts[1], round_keys) == ciphertexts[1])
+                    expected.push_back((uint16_t)k);
+            }
+            BitslicedSAES::search_keys(0, (size_t)1 << 16, plaintexts, ciphertexts, 2, found, isa);
+            if(found != expected) mismatch("search_keys", isa, (size_t)1 << 16, "keys");
+        }
+    }
+    return correct;
+}
+
+int main(int argc, char** argv){
+    const int key = 0x3A94;
+    Config config;
+    try {
+        config = parse(argc, argv);
+    } catch(const exception& e) {
+        fprintf(stderr, "saes_bench: %s\n", e.what());
+        usage();
+        return 2;
+    }
+
+    if(!check_kernels()) return 1;
+    printf("Bitsliced kernels match FastSAES on every supported instruction set\n\n");
+
+    if(config.latency){
+        latency_table(key);
+        multi_key_table();
+        key_search_table(key);
+    }
+
+    vector<Case> cases = build_cases(key, config);
+    vector<Stats> results;
+    bool correct = true;
+    printf("Engines and modes by message size (%d thread%s, median of each case)\n\n", config.threads, config.threads == 1 ? "" : "s");
+    printf("%-18s %-4s %10s %6s %13s %13s %11s %10s %8s\n",
+           "Engine", "Op", "Bytes", "Iter", "Median (ns)", "p99 (ns)", "Stddev (%)", "MB/s", "cyc/B");
+
+    for(size_t size : config.sizes){
+        vector<uint8_t> message = load_message(size, config);
+        vector<uint8_t> buffer(message);
+        for(auto &c : cases){
+            if(size > c.max_size) continue;
+            for(bool decrypt : {false, true}){
+                auto &op = decrypt ? c.decrypt : c.encrypt;
+                Stats stats = measure([&] { op(buffer.data(), size); }, size, config);
+                stats.engine = c.name;
+                stats.operation = decrypt ? "dec" : "enc";
+                results.push_back(stats);
+                printf("%-18s %-4s %10zu %6zu %13.0f %13.0f %11.1f %10.1f %8.2f\n", c.name.c_str(), stats.operation.c_str(),
+                       size, stats.iterations, stats.median_ns, stats.p99_ns, 100 * stats.stddev_ns / stats.mean_ns,
+                       stats.mb_per_s, stats.cycles_per_byte);
+            }
+
+            // Round trip on the original message, as the Python analysis checks
+            memcpy(buffer.data(), message.data(), size);
+            c.encrypt(buffer.data(), size);
+            c.decrypt(buffer.data(), size);
+            if(buffer != message){
+                fprintf(stderr, "saes_bench: %s does not decrypt its own ciphertext (%zu bytes)\n", c.name.c_str(), size);
+                correct = false;
+            }
+        }
+        printf("\n");
+    }
+    sink = results.size();
+
+    if(!config.csv.empty()) write_csv(config.csv, results);
+    if(!config.json.empty()) write_json(config.json, results, key, config);
+    return correct ? 0 : 1;
+}
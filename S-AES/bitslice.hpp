@@ -0,0 +1,596 @@
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cassert>
+#include <array>
+#include <vector>
+
+#include "gf16.hpp"
+#include "fast-saes.hpp"
+#include "instrument.hpp"
+
+using namespace std;
+
+#ifndef BITSLICE_HPP
+#define BITSLICE_HPP
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SAES_X86_DISPATCH 1
+#endif
+
+#define SAES_INLINE inline __attribute__((always_inline))
+
+/**
+ * @class BitslicedSAES
+ * @brief Bitsliced S-AES engine encrypting 64 to 512 blocks per pass of boolean operations.
+ *
+ * @details Instead of processing one 16-bit block at a time, the state of W blocks is stored as
+ * 16 bit-planes: plane b is a W-bit word whose lane i holds bit b of block i. Every S-AES step then
+ * becomes a fixed sequence of bitwise operations applied to all W blocks at once:
+ * - SubNibbles: a boolean circuit (the algebraic normal form of the 4-bit S-box)
+ * - ShiftRows: renaming of planes (no instruction at all)
+ * - MixColumns: XORs only, since multiplying by a constant in GF(2⁴) is linear over GF(2)
+ * - AddRoundKey: XOR with all-zeros / all-ones planes
+ *
+ * The plane word is a 64-bit integer (scalar, 64 blocks) or a 128/256/512-bit vector (SSE2, AVX2,
+ * AVX-512: 128, 256, 512 blocks). The widest instruction set supported by the running CPU is selected
+ * at runtime. Byte buffers are converted to and from bit-planes by a transpose layer
+ * (16×16 bit-matrix transposes), blocks being read big-endian as in the ECB class.
+ */
+class BitslicedSAES {
+public:
+
+    enum ISA { SCALAR, SSE2, AVX2, AVX512 };
+
+    int key;
+    ISA isa;
+
+    /**
+     * @brief Constructs a bitsliced engine for the given key.
+     *
+     * @param key_ The 16-bit encryption key.
+     * @param isa_ Instruction set to use (default: the best one supported by the CPU).
+     */
+    BitslicedSAES(int key_, ISA isa_ = best_isa()) : isa(isa_) {
+        rekey(key_);
+    }
+
+    /**
+     * @brief Replaces the key and recomputes the round keys.
+     *
+     * @param key_ The new 16-bit encryption key.
+     */
+    void rekey(int key_) {
+        key = key_;
+        FastSAES::expand_key((uint16_t)key, round_keys);
+    }
+
+    /**
+     * @brief Encrypts 'blocks' 16-bit big-endian blocks from 'in' into 'out'.
+     *
+     * @param in Input buffer of 2 * blocks bytes.
+     * @param out Output buffer of 2 * blocks bytes (may be equal to 'in').
+     * @param blocks Number of 16-bit blocks.
+     */
+    void encrypt(const uint8_t* in, uint8_t* out, size_t blocks) const {
+        run(in, out, blocks, false);
+    }
+
+    /**
+     * @brief Decrypts 'blocks' 16-bit big-endian blocks from 'in' into 'out'.
+     *
+     * @param in Input buffer of 2 * blocks bytes.
+     * @param out Output buffer of 2 * blocks bytes (may be equal to 'in').
+     * @param blocks Number of 16-bit blocks.
+     */
+    void decrypt(const uint8_t* in, uint8_t* out, size_t blocks) const {
+        run(in, out, blocks, true);
+    }
+
+    /**
+     * @brief Encrypts count blocks, each under its own key, in one vectorized pass.
+     *
+     * @details Structure-of-arrays batch API for workloads using thousands of distinct keys:
+     * block i is encrypted under keys[i]. Keys and blocks are transposed into bit-planes together,
+     * so every lane of the kernel holds a different key; the key schedules of a whole batch are
+     * expanded at once by the bitsliced key expansion. No per-key object, branch or allocation.
+     *
+     * @param keys Array of 'count' 16-bit keys.
+     * @param blocks Array of 'count' 16-bit plaintext blocks.
+     * @param out Output array of 'count' ciphertext blocks (may be equal to 'blocks').
+     * @param count Number of (key, block) pairs.
+     * @param isa Instruction set to use.
+     */
+    static void encrypt_many(const uint16_t* keys, const uint16_t* blocks, uint16_t* out, size_t count,
+                             ISA isa = best_isa()) {
+        run_many(keys, blocks, out, count, false, isa);
+    }
+
+    /**
+     * @brief Decrypts count blocks, each under its own key, in one vectorized pass (see encrypt_many).
+     *
+     * @param keys Array of 'count' 16-bit keys.
+     * @param blocks Array of 'count' 16-bit ciphertext blocks.
+     * @param out Output array of 'count' plaintext blocks (may be equal to 'blocks').
+     * @param count Number of (key, block) pairs.
+     * @param isa Instruction set to use.
+     */
+    static void decrypt_many(const uint16_t* keys, const uint16_t* blocks, uint16_t* out, size_t count,
+                             ISA isa = best_isa()) {
+        run_many(keys, blocks, out, count, true, isa);
+    }
+
+    /**
+     * @brief Finds the keys of a range that encrypt every known plaintext into its ciphertext.
+     *
+     * @details Bitsliced across keys: each lane of the kernel holds a different key and the
+     * round keys of a whole batch are expanded with the same boolean circuits as the rounds,
+     * so one pass tests 64 to 512 keys against a pair. Additional pairs are only evaluated
+     * for batches where some key is still consistent.
+     *
+     * @param first First key of the range, a multiple of batch_blocks(isa).
+     * @param count Number of keys, a multiple of batch_blocks(isa) (first + count ≤ 65,536).
+     * @param plaintexts Array of 'pairs' known plaintext blocks.
+     * @param ciphertexts Array of the 'pairs' matching ciphertext blocks.
+     * @param pairs Number of known pairs.
+     * @param found Receives the consistent keys, in increasing order.
+     * @param isa Instruction set to use.
+     */
+    static void search_keys(uint32_t first, size_t count, const uint16_t* plaintexts, const uint16_t* ciphertexts,
+                            size_t pairs, vector<uint16_t>& found, ISA isa = best_isa()) {
+        assert(first % batch_blocks(isa) == 0 && count % batch_blocks(isa) == 0 && first + count <= (1 << 16));
+        Instrument::count(Instrument::KEY_EXPANSIONS, count);
+        Instrument::Timer timer(Instrument::KEY_SEARCH);
+#ifdef SAES_X86_DISPATCH
+        switch(isa){
+            case AVX512: search_avx512(first, count, plaintexts, ciphertexts, pairs, found); return;
+            case AVX2: search_avx2(first, count, plaintexts, ciphertexts, pairs, found); return;
+            case SSE2: search_sse2(first, count, plaintexts, ciphertexts, pairs, found); return;
+            default: break;
+        }
+#endif
+        search_scalar(first, count, plaintexts, ciphertexts, pairs, found);
+    }
+
+    /**
+     * @brief Returns the widest instruction set supported by the running CPU.
+     */
+    static ISA best_isa() {
+#ifdef SAES_X86_DISPATCH
+        static const ISA best = [] {
+            __builtin_cpu_init();
+            if(__builtin_cpu_supports("avx512f")) return AVX512;
+            if(__builtin_cpu_supports("avx2")) return AVX2;
+            if(__builtin_cpu_supports("sse2")) return SSE2;
+            return SCALAR;
+        }();
+        return best;
+#else
+        return SCALAR;
+#endif
+    }
+
+    /**
+     * @brief Returns the printable name of an instruction set.
+     */
+    static const char* isa_name(ISA isa) {
+        const char* names[] = {"scalar", "SSE2", "AVX2", "AVX-512"};
+        return names[isa];
+    }
+
+    /**
+     * @brief Returns the number of blocks processed by one pass of the kernel for an instruction set.
+     */
+    static size_t batch_blocks(ISA isa) {
+        return (size_t)64 << isa;
+    }
+
+private:
+
+    uint16_t round_keys[3];
+
+    typedef uint64_t u64x2 __attribute__((vector_size(16)));
+    typedef uint64_t u64x4 __attribute__((vector_size(32)));
+    typedef uint64_t u64x8 __attribute__((vector_size(64)));
+
+    // ANF[d][i]: algebraic normal form of output bit i of the (inverse) S-box,
+    // bit m set ⇔ the monomial ∏_{j ∈ m} x_j appears in the XOR sum
+    static constexpr array<array<uint16_t, 4>, 2> ANF = [] {
+        array<array<uint16_t, 4>, 2> anf{};
+        for(int d=0; d < 2; d++){
+            for(int i=0; i < 4; i++){
+                uint16_t truth = 0;
+                for(int x=0; x < 16; x++) truth |= (uint16_t)(((SAES_SBOX[d][x] >> i) & 1) << x);
+                // Möbius transform: truth table → ANF coefficients
+                for(int step=1; step < 16; step <<= 1){
+                    for(int x=0; x < 16; x++){
+                        if(x & step) truth ^= (uint16_t)(((truth >> (x ^ step)) & 1) << x);
+                    }
+                }
+                anf[d][i] = truth;
+            }
+        }
+        return anf;
+    }();
+
+    // LINEAR[c][i]: bit j set ⇔ input bit j contributes to output bit i of the product c·x in GF(2⁴)
+    static constexpr array<array<uint8_t, 4>, 16> LINEAR = [] {
+        array<array<uint8_t, 4>, 16> matrix{};
+        for(int c=0; c < 16; c++){
+            for(int j=0; j < 4; j++){
+                int column = GF_16::mul(c, 1 << j);
+                for(int i=0; i < 4; i++) matrix[c][i] |= (uint8_t)(((column >> i) & 1) << j);
+            }
+        }
+        return matrix;
+    }();
+
+    // Applies the (inverse) S-box circuit to the 4 planes x[0..3] of one nibble
+    template<class V>
+    static SAES_INLINE void sub_nibble(V* x, bool decrypt) {
+        V mono[16];
+        mono[0] = ~(x[0] ^ x[0]);
+#pragma GCC unroll 16
+        for(int m=1; m < 16; m++){
+            int high = 31 - __builtin_clz(m);
+            mono[m] = (m == (1 << high)) ? x[high] : (mono[m ^ (1 << high)] & x[high]);
+        }
+#pragma GCC unroll 4
+        for(int i=0; i < 4; i++){
+            V out = x[0] ^ x[0];
+#pragma GCC unroll 16
+            for(int m=0; m < 16; m++){
+                if((ANF[decrypt][i] >> m) & 1) out ^= mono[m];
+            }
+            x[i] = out;
+        }
+    }
+
+    template<class V>
+    static SAES_INLINE void sub_nibbles(V* s, bool decrypt) {
+        for(int n=0; n < 4; n++) sub_nibble(s + 4 * n, decrypt);
+    }
+
+    // Swaps nibble 0 (bits 3-0) and nibble 2 (bits 11-8)
+    template<class V>
+    static SAES_INLINE void shift_rows(V* s) {
+        for(int b=0; b < 4; b++){
+            V t = s[b];
+            s[b] = s[b + 8];
+            s[b + 8] = t;
+        }
+    }
+
+    // out ^= c · x, for the 4 planes of a nibble
+    template<class V>
+    static SAES_INLINE void mul_add(V* out, const V* x, int c) {
+#pragma GCC unroll 4
+        for(int i=0; i < 4; i++){
+#pragma GCC unroll 4
+            for(int j=0; j < 4; j++){
+                if((LINEAR[c][i] >> j) & 1) out[i] ^= x[j];
+            }
+        }
+    }
+
+    template<class V>
+    static SAES_INLINE void mix_columns(V* s, bool decrypt) {
+        const uint8_t (&m)[2][2] = SAES_MIX[decrypt];
+        // Column 0: top = bits 15-12, bottom = bits 11-8 | Column 1: top = bits 7-4, bottom = bits 3-0
+        for(int column=0; column < 2; column++){
+            V* top = s + (column == 0 ? 12 : 4);
+            V* bottom = s + (column == 0 ? 8 : 0);
+            V t[4], u[4];
+            for(int i=0; i < 4; i++) t[i] = u[i] = top[i] ^ top[i];
+            mul_add(t, top, m[0][0]);
+            mul_add(t, bottom, m[0][1]);
+            mul_add(u, top, m[1][0]);
+            mul_add(u, bottom, m[1][1]);
+            for(int i=0; i < 4; i++){
+                top[i] = t[i];
+                bottom[i] = u[i];
+            }
+        }
+    }
+
+    template<class V>
+    static SAES_INLINE void add_round_key(V* s, const V* k) {
+        for(int b=0; b < 16; b++) s[b] ^= k[b];
+    }
+
+    // The two rounds following the initial AddRoundKey of encryption
+    template<class V>
+    static SAES_INLINE void encrypt_rounds(V* s, const V (*keys)[16]) {
+        sub_nibbles(s, false);
+        shift_rows(s);
+        mix_columns(s, false);
+        add_round_key(s, keys[1]);
+        sub_nibbles(s, false);
+        shift_rows(s);
+        add_round_key(s, keys[2]);
+    }
+
+    /*  Derives the planes of Key1 and Key2 from those of Key0 in keys[0], one key per lane:
+        w2 = w0 ⊕ RCON1 ⊕ SubNib(RotNib(w1)), w3 = w2 ⊕ w1 (planes 15-8 hold w0, planes 7-0 w1).
+    */
+    template<class V>
+    static SAES_INLINE void expand_key_planes(V (*keys)[16]) {
+        for(int round=1; round <= 2; round++){
+            const V* w = keys[round - 1];
+            V* next = keys[round];
+            V t[8];
+            for(int b=0; b < 4; b++){
+                t[b] = w[b + 4];
+                t[b + 4] = w[b];
+            }
+            sub_nibble(t, false);
+            sub_nibble(t + 4, false);
+            for(int b=0; b < 8; b++){
+                V high = w[b + 8] ^ t[b];
+                if((FastSAES::RCON[round - 1] >> b) & 1) high = ~high;
+                next[b + 8] = high;
+                next[b] = w[b] ^ high;
+            }
+        }
+    }
+
+    /*  Processes 'count' (key, block) pairs with a plane word of type V, one pair per lane.
+        Keys and blocks are native 16-bit values, transposed into planes with the same lane order,
+        so no byte swap is needed; a trailing partial batch goes through zero-padded copies.
+    */
+    template<class V>
+    static SAES_INLINE void process_many(const uint16_t* keys_in, const uint16_t* blocks, uint16_t* out,
+                                         size_t count, bool decrypt) {
+        const size_t lanes = 8 * sizeof(V);
+        for(size_t offset=0; offset < count; offset += lanes){
+            size_t size = (count - offset < lanes ? count - offset : lanes) * sizeof(uint16_t);
+            V keys[3][16], s[16];
+            if(size < sizeof(s)){
+                memset(keys[0], 0, sizeof(keys[0]));
+                memset(s, 0, sizeof(s));
+            }
+            memcpy(keys[0], keys_in + offset, size);
+            memcpy(s, blocks + offset, size);
+            transpose(keys[0]);
+            transpose(s);
+            expand_key_planes(keys);
+
+            if(!decrypt){
+                add_round_key(s, keys[0]);
+                encrypt_rounds(s, keys);
+            } else {
+                add_round_key(s, keys[2]);
+                shift_rows(s);
+                sub_nibbles(s, true);
+                add_round_key(s, keys[1]);
+                mix_columns(s, true);
+                shift_rows(s);
+                sub_nibbles(s, true);
+                add_round_key(s, keys[0]);
+            }
+
+            transpose(s);
+            memcpy(out + offset, s, size);
+        }
+    }
+
+    /*  Tests the keys [first, first + count) against every known pair, one key per lane:
+        lane i of a batch holds key first + i, its planes being fixed bit patterns for the low
+        6 bits and constants per 64-bit element above. The key schedule is expanded once per batch
+        and shared by all pairs; the remaining pairs are skipped as soon as no lane survives.
+        'first' and 'count' are multiples of the lane count.
+    */
+    template<class V>
+    static SAES_INLINE void search(uint32_t first, size_t count, const uint16_t* plaintexts,
+                                   const uint16_t* ciphertexts, size_t pairs, vector<uint16_t>& found) {
+        const uint64_t patterns[6] = {
+            0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+            0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL
+        };
+        const size_t elements = sizeof(V) / 8, lanes = 8 * sizeof(V);
+
+        for(size_t offset=0; offset < count; offset += lanes){
+            uint32_t base = first + (uint32_t)offset;
+            uint64_t words[16][elements];
+            for(int b=0; b < 16; b++){
+                for(size_t e=0; e < elements; e++){
+                    uint32_t lane0 = base + 64 * (uint32_t)e;
+                    words[b][e] = b < 6 ? patterns[b] : ((lane0 >> b) & 1) ? ~0ULL : 0;
+                }
+            }
+            V keys[3][16];
+            memcpy(keys[0], words, sizeof(keys[0]));
+            expand_key_planes(keys);
+
+            V zero = {}, match = ~zero;
+            for(size_t p=0; p < pairs; p++){
+                V s[16];
+                for(int b=0; b < 16; b++) s[b] = ((plaintexts[p] >> b) & 1) ? ~keys[0][b] : keys[0][b];
+                encrypt_rounds(s, keys);
+                V diff = zero;
+                for(int b=0; b < 16; b++) diff |= ((ciphertexts[p] >> b) & 1) ? ~s[b] : s[b];
+                match &= ~diff;
+
+                uint64_t any = 0;
+                memcpy(words[0], &match, sizeof(V));
+                for(size_t e=0; e < elements; e++) any |= words[0][e];
+                if(!any) break;
+            }
+
+            memcpy(words[0], &match, sizeof(V));
+            for(size_t e=0; e < elements; e++){
+                for(uint64_t bits = words[0][e]; bits; bits &= bits - 1){
+                    found.push_back((uint16_t)(base + 64 * e + __builtin_ctzll(bits)));
+                }
+            }
+        }
+    }
+
+    // Swaps the two bytes of every 16-bit field: big-endian blocks ↔ native little-endian fields
+    template<class V>
+    static SAES_INLINE void swap_bytes(V* w) {
+        for(int r=0; r < 16; r++){
+            w[r] = ((w[r] & 0x00FF00FF00FF00FFULL) << 8) | ((w[r] >> 8) & 0x00FF00FF00FF00FFULL);
+        }
+    }
+
+    /*  Transposes the 16×16 bit matrices held in every 16-bit field of w[0..15]
+        (field f of w[r], bit c  ↔  field f of w[c], bit r). The transpose is its own inverse,
+        so the same routine converts blocks to bit-planes and back.
+    */
+    template<class V>
+    static SAES_INLINE void transpose(V* w) {
+        const uint64_t masks[4] = {
+            0x00FF00FF00FF00FFULL, 0x0F0F0F0F0F0F0F0FULL, 0x3333333333333333ULL, 0x5555555555555555ULL
+        };
+        for(int stage=0, j=8; j > 0; stage++, j >>= 1){
+            for(int r=0; r < 16; r++){
+                if(r & j) continue;
+                V t = ((w[r] >> j) ^ w[r + j]) & masks[stage];
+                w[r + j] ^= t;
+                w[r] ^= t << j;
+            }
+        }
+    }
+
+    /*  Processes 'blocks' blocks with a plane word of type V. One batch is 16 words, i.e.
+        16 * sizeof(V) bytes; word r holds consecutive blocks, 4 per 64-bit element.
+        A trailing partial batch goes through a zero-padded copy.
+    */
+    template<class V>
+    static SAES_INLINE void process(const uint8_t* in, uint8_t* out, size_t blocks,
+                                    const uint16_t round_keys[3], bool decrypt) {
+        const size_t batch_bytes = 16 * sizeof(V), bytes = 2 * blocks;
+        V keys[3][16];
+        for(int r=0; r < 3; r++){
+            for(int b=0; b < 16; b++){
+                V zero = {};
+                keys[r][b] = ((round_keys[r] >> b) & 1) ? ~zero : zero;
+            }
+        }
+
+        for(size_t offset=0; offset < bytes; offset += batch_bytes){
+            size_t size = bytes - offset < batch_bytes ? bytes - offset : batch_bytes;
+            V s[16];
+            if(size == batch_bytes){
+                memcpy(s, in + offset, batch_bytes);
+            } else {
+                memset(s, 0, batch_bytes);
+                memcpy(s, in + offset, size);
+            }
+            swap_bytes(s);
+            transpose(s);
+
+            if(!decrypt){
+                add_round_key(s, keys[0]);
+                encrypt_rounds(s, keys);
+            } else {
+                add_round_key(s, keys[2]);
+                shift_rows(s);
+                sub_nibbles(s, true);
+                add_round_key(s, keys[1]);
+                mix_columns(s, true);
+                shift_rows(s);
+                sub_nibbles(s, true);
+                add_round_key(s, keys[0]);
+            }
+
+            transpose(s);
+            swap_bytes(s);
+            memcpy(out + offset, s, size);
+        }
+    }
+
+    static void process_scalar(const uint8_t* in, uint8_t* out, size_t blocks, const uint16_t rk[3], bool d) {
+        process<uint64_t>(in, out, blocks, rk, d);
+    }
+
+    static void many_scalar(const uint16_t* k, const uint16_t* b, uint16_t* out, size_t count, bool d) {
+        process_many<uint64_t>(k, b, out, count, d);
+    }
+
+    static void search_scalar(uint32_t first, size_t count, const uint16_t* p, const uint16_t* c, size_t pairs,
+                              vector<uint16_t>& found) {
+        search<uint64_t>(first, count, p, c, pairs, found);
+    }
+
+#ifdef SAES_X86_DISPATCH
+    __attribute__((target("sse2")))
+    static void many_sse2(const uint16_t* k, const uint16_t* b, uint16_t* out, size_t count, bool d) {
+        process_many<u64x2>(k, b, out, count, d);
+    }
+
+    __attribute__((target("avx2")))
+    static void many_avx2(const uint16_t* k, const uint16_t* b, uint16_t* out, size_t count, bool d) {
+        process_many<u64x4>(k, b, out, count, d);
+    }
+
+    __attribute__((target("avx512f")))
+    static void many_avx512(const uint16_t* k, const uint16_t* b, uint16_t* out, size_t count, bool d) {
+        process_many<u64x8>(k, b, out, count, d);
+    }
+
+    __attribute__((target("sse2")))
+    static void search_sse2(uint32_t first, size_t count, const uint16_t* p, const uint16_t* c, size_t pairs,
+                            vector<uint16_t>& found) {
+        search<u64x2>(first, count, p, c, pairs, found);
+    }
+
+    __attribute__((target("avx2")))
+    static void search_avx2(uint32_t first, size_t count, const uint16_t* p, const uint16_t* c, size_t pairs,
+                            vector<uint16_t>& found) {
+        search<u64x4>(first, count, p, c, pairs, found);
+    }
+
+    __attribute__((target("avx512f")))
+    static void search_avx512(uint32_t first, size_t count, const uint16_t* p, const uint16_t* c, size_t pairs,
+                              vector<uint16_t>& found) {
+        search<u64x8>(first, count, p, c, pairs, found);
+    }
+
+    __attribute__((target("sse2")))
+    static void process_sse2(const uint8_t* in, uint8_t* out, size_t blocks, const uint16_t rk[3], bool d) {
+        process<u64x2>(in, out, blocks, rk, d);
+    }
+
+    __attribute__((target("avx2")))
+    static void process_avx2(const uint8_t* in, uint8_t* out, size_t blocks, const uint16_t rk[3], bool d) {
+        process<u64x4>(in, out, blocks, rk, d);
+    }
+
+    __attribute__((target("avx512f")))
+    static void process_avx512(const uint8_t* in, uint8_t* out, size_t blocks, const uint16_t rk[3], bool d) {
+        process<u64x8>(in, out, blocks, rk, d);
+    }
+#endif
+
+    static void run_many(const uint16_t* keys, const uint16_t* blocks, uint16_t* out, size_t count, bool decrypt, ISA isa) {
+        Instrument::count(Instrument::BLOCKS, count);
+        Instrument::count(Instrument::KEY_EXPANSIONS, count);
+        Instrument::Timer timer(Instrument::BITSLICED);
+#ifdef SAES_X86_DISPATCH
+        switch(isa){
+            case AVX512: many_avx512(keys, blocks, out, count, decrypt); return;
+            case AVX2: many_avx2(keys, blocks, out, count, decrypt); return;
+            case SSE2: many_sse2(keys, blocks, out, count, decrypt); return;
+            default: break;
+        }
+#endif
+        many_scalar(keys, blocks, out, count, decrypt);
+    }
+
+    void run(const uint8_t* in, uint8_t* out, size_t blocks, bool decrypt) const {
+        Instrument::Timer timer(Instrument::BITSLICED);
+#ifdef SAES_X86_DISPATCH
+        switch(isa){
+            case AVX512: process_avx512(in, out, blocks, round_keys, decrypt); return;
+            case AVX2: process_avx2(in, out, blocks, round_keys, decrypt); return;
+            case SSE2: process_sse2(in, out, blocks, round_keys, decrypt); return;
+            default: break;
+        }
+#endif
+        process_scalar(in, out, blocks, round_keys, decrypt);
+    }
+};
+
+#endif
@@ -0,0 +1,117 @@
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "instrument.hpp"
+
+using namespace std;
+
+#ifndef BUFFER_POOL_HPP
+#define BUFFER_POOL_HPP
+
+/**
+ * @class BufferPool
+ * @brief Per-thread pool of reusable byte buffers for the codec and cipher pipeline.
+ *
+ * @details A Buffer leases a byte vector from the calling thread's free list and gives it back,
+ * with its capacity, when it goes out of scope. Once every buffer size a workload needs has been
+ * seen, acquiring a buffer allocates nothing: a process encrypting many small messages runs with
+ * no heap allocation in steady state (together with the output-parameter overloads of ECB, Base64
+ * and Hex). Each thread has its own list, so leasing takes no lock; a buffer must be released by
+ * the thread that acquired it. Only a few buffers are kept per thread, and very large ones are
+ * freed rather than retained, so the pool does not hold on to the memory of a one-off large
+ * message. Growing a buffer counts as an allocation in the instrumentation counters.
+ */
+class BufferPool {
+public:
+
+    static const size_t MAX_FREE = 8;               // Free buffers kept per thread
+    static const size_t MAX_RETAINED = 1 << 20;     // Larger buffers are freed when released
+
+    /**
+     * @class Buffer
+     * @brief A byte buffer leased from the pool of the calling thread.
+     */
+    class Buffer {
+    public:
+
+        /**
+         * @brief Leases a buffer of 'size' bytes (contents unspecified).
+         */
+        explicit Buffer(size_t size = 0) : bytes(take()) {
+            resize(size);
+        }
+
+        ~Buffer() {
+            give(move(bytes));
+        }
+
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+
+        /**
+         * @brief Changes the size; allocates only when the leased capacity is exceeded.
+         */
+        void resize(size_t size) {
+            BufferPool::resize(bytes, size);
+        }
+
+        uint8_t* data() { return bytes.data(); }
+        const uint8_t* data() const { return bytes.data(); }
+        size_t size() const { return bytes.size(); }
+
+        operator span<uint8_t>() { return bytes; }
+        operator span<const uint8_t>() const { return bytes; }
+
+    private:
+
+        vector<uint8_t> bytes;
+    };
+
+    /**
+     * @brief Resizes a string or byte vector owned by the caller (e.g. a reused output), counting
+     * an allocation when its capacity is exceeded.
+     */
+    template<class Bytes>
+    static void resize(Bytes& bytes, size_t size) {
+        if(size > bytes.capacity()) Instrument::count(Instrument::ALLOCATIONS);
+        bytes.resize(size);
+    }
+
+    /**
+     * @brief Returns the number of free buffers kept by the calling thread.
+     */
+    static size_t free_buffers() {
+        return free_list().size();
+    }
+
+private:
+
+    static vector<vector<uint8_t>>& free_list() {
+        thread_local vector<vector<uint8_t>> list = [] {
+            vector<vector<uint8_t>> buffers;
+            buffers.reserve(MAX_FREE);
+            return buffers;
+        }();
+        return list;
+    }
+
+    // Most recently released buffer first: the likeliest to be large enough and in cache
+    static vector<uint8_t> take() {
+        auto &list = free_list();
+        if(list.empty()) return {};
+        vector<uint8_t> bytes = move(list.back());
+        list.pop_back();
+        return bytes;
+    }
+
+    static void give(vector<uint8_t>&& bytes) {
+        auto &list = free_list();
+        if(list.size() >= MAX_FREE || bytes.capacity() > MAX_RETAINED) return;
+        list.push_back(move(bytes));
+    }
+};
+
+#endif
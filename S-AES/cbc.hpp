@@ -0,0 +1,206 @@
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "fast-saes.hpp"
+#include "bitslice.hpp"
+#include "thread-pool.hpp"
+#include "padding.hpp"
+#include "util.hpp"
+#include "base64.hpp"
+
+using namespace std;
+
+#ifndef CBC_HPP
+#define CBC_HPP
+
+/**
+ * @class CBC
+ * @brief CBC (Cipher Block Chaining) mode encryption class for S-AES.
+ *
+ * @details C_i = E(P_i ⊕ C_{i-1}) with C_{-1} = IV, and P_i = D(C_i) ⊕ C_{i-1}.
+ *
+ * Encryption is inherently serial (each block needs the previous ciphertext), so it runs block by
+ * block on the fast path. Decryption has no such dependency: every plaintext block only needs two
+ * ciphertext blocks, so the ciphertext is decrypted in bulk by the bitsliced engine, chunk by chunk
+ * on the thread pool when one is set, and then XORed with itself shifted by one block.
+ *
+ * The span API processes whole blocks and keeps the chaining value between calls, so a message
+ * can be streamed in several chunks. The string API works on complete messages, starting from the
+ * IV every time, and applies PKCS#7 padding when 'padding' is set.
+ */
+class CBC {
+public:
+
+    static const size_t ALIGNMENT = 2;          // Inputs are whole 16-bit blocks
+    static const size_t CHUNK_BLOCKS = 1 << 14; // 32 KiB per parallel task
+
+    int key;
+    int iv;
+    bool padding;
+
+    /**
+     * @brief Constructs a CBC mode encryption object.
+     *
+     * @param key_ The 16-bit key.
+     * @param iv_ The 16-bit initialization vector.
+     * @param padding_ Applies PKCS#7 padding in the string and streaming APIs (default: true).
+     */
+    CBC(int key_, int iv_, bool padding_ = true) : key(key_), iv(iv_), padding(padding_), bitsliced(key_) {
+        FastSAES::expand_key((uint16_t)key, round_keys);
+        chain = (uint16_t)iv;
+    }
+
+    /**
+     * @brief Replaces the key and IV and restarts the chain.
+     */
+    void rekey(int key_, int iv_) {
+        key = key_;
+        bitsliced.rekey(key_);
+        FastSAES::expand_key((uint16_t)key, round_keys);
+        reset(iv_);
+    }
+
+    /**
+     * @brief Restarts the chain from a new IV (start of a new message).
+     */
+    void reset(int iv_) {
+        iv = iv_;
+        chain = (uint16_t)iv;
+    }
+
+    /**
+     * @brief Sets the number of threads used for decrypting large inputs (1: serial, 0: one per hardware thread).
+     */
+    void set_threads(int threads) {
+        pool = threads == 1 ? nullptr : make_shared<ThreadPool>(threads);
+    }
+
+    /**
+     * @brief Uses an existing thread pool (possibly shared with other modes), or nullptr for serial processing.
+     */
+    void set_pool(shared_ptr<ThreadPool> pool_) {
+        pool = pool_;
+    }
+
+    /**
+     * @brief Encrypts whole blocks of 'in' into 'out', continuing the current chain. In-place allowed.
+     *
+     * @throws invalid_argument if the length is odd or the output is too small.
+     */
+    void encrypt(span<const uint8_t> in, span<uint8_t> out) {
+        Instrument::count_bytes(in.size());
+        Instrument::Timer timer(Instrument::CIPHER);
+        check_blocks(in, out);
+        uint16_t previous = chain;
+        for(size_t i=0; i < in.size(); i += 2){
+            uint16_t block = (uint16_t)((in[i] << 8) | in[i + 1]);
+            previous = FastSAES::encrypt(block ^ previous, round_keys);
+            out[i] = previous >> 8;
+            out[i + 1] = previous & 0xFF;
+        }
+        chain = previous;
+    }
+
+    /**
+     * @brief Decrypts whole blocks of 'in' into 'out', continuing the current chain. In-place allowed.
+     *
+     * @details Runs in parallel chunks when a thread pool is set and the input is large.
+     *
+     * @throws invalid_argument if the length is odd or the output is too small.
+     */
+    void decrypt(span<const uint8_t> in, span<uint8_t> out) {
+        Instrument::count_bytes(in.size());
+        Instrument::Timer timer(Instrument::CIPHER);
+        check_blocks(in, out);
+        size_t blocks = in.size() / 2;
+        if(blocks == 0) return;
+
+        // Chaining value entering each chunk, read before any chunk may overwrite it (in-place)
+        size_t chunks = (blocks + CHUNK_BLOCKS - 1) / CHUNK_BLOCKS;
+        vector<uint16_t> entry(chunks);
+        entry[0] = chain;
+        for(size_t c=1; c < chunks; c++) entry[c] = read_block(in, c * CHUNK_BLOCKS - 1);
+        chain = read_block(in, blocks - 1);
+
+        auto decrypt_chunks = [&](size_t begin, size_t end) {
+            vector<uint8_t> cipher(2 * min(CHUNK_BLOCKS, blocks));
+            for(size_t c=begin; c < end; c++){
+                size_t first = c * CHUNK_BLOCKS, count = min(CHUNK_BLOCKS, blocks - first);
+                decrypt_chunk(in.subspan(2 * first, 2 * count), out.subspan(2 * first), entry[c], cipher.data());
+            }
+        };
+        if(pool && chunks > 1) pool->parallel_for(chunks, 1, decrypt_chunks);
+        else decrypt_chunks(0, chunks);
+    }
+
+    /**
+     * @brief Encrypts a complete plaintext string from the IV and returns the ciphertext in Base64.
+     *
+     * @throws invalid_argument if padding is disabled and the length is not a multiple of the block.
+     */
+    string encrypt(const string& plainText) {
+        if(!padding && plainText.size() % 2 != 0) throw invalid_argument("plaintext length must be a multiple of 2 bytes");
+        vector<uint8_t> bytes(plainText.begin(), plainText.end());
+        if(padding){
+            bytes.resize(bytes.size() + PKCS7::pad_length(bytes.size()));
+            PKCS7::pad(bytes.data(), plainText.size());
+        }
+        reset(iv);
+        encrypt(bytes, bytes);
+        return Base64::convert_to(bytes);
+    }
+
+    /**
+     * @brief Decrypts a complete Base64-encoded ciphertext from the IV and returns the plaintext.
+     *
+     * @throws invalid_argument if the ciphertext is not whole blocks or the padding is invalid.
+     */
+    string decrypt(const string& cipherText) {
+        vector<uint8_t> bytes = Base64::decode(cipherText);
+        if(bytes.size() % 2 != 0) throw invalid_argument("ciphertext length must be a multiple of 2 bytes");
+        reset(iv);
+        decrypt(bytes, bytes);
+        size_t size = padding ? PKCS7::unpad(bytes.data(), bytes.size()) : bytes.size();
+        return string(bytes.begin(), bytes.begin() + size);
+    }
+
+private:
+
+    uint16_t round_keys[3];
+    uint16_t chain;             // Last ciphertext block (or IV) of the current message
+    BitslicedSAES bitsliced;
+    shared_ptr<ThreadPool> pool;
+
+    static void check_blocks(span<const uint8_t> in, span<uint8_t> out) {
+        if(in.size() % 2 != 0) throw invalid_argument("length must be a multiple of 2 bytes");
+        if(out.size() < in.size()) throw invalid_argument("output buffer too small");
+    }
+
+    static uint16_t read_block(span<const uint8_t> bytes, size_t index) {
+        return (uint16_t)((bytes[2 * index] << 8) | bytes[2 * index + 1]);
+    }
+
+    // P_i = D(C_i) ⊕ C_{i-1} for one chunk; 'cipher' is scratch space so that in == out works
+    void decrypt_chunk(span<const uint8_t> in, span<uint8_t> out, uint16_t previous, uint8_t* cipher) const {
+        size_t size = in.size();
+        memcpy(cipher, in.data(), size);
+        if(size / 2 >= BitslicedSAES::batch_blocks(bitsliced.isa)){
+            bitsliced.decrypt(cipher, out.data(), size / 2);
+        } else {
+            for(size_t i=0; i < size; i += 2){
+                uint16_t block = FastSAES::decrypt((uint16_t)((cipher[i] << 8) | cipher[i + 1]), round_keys);
+                out[i] = block >> 8;
+                out[i + 1] = block & 0xFF;
+            }
+        }
+        out[0] ^= previous >> 8;
+        out[1] ^= previous & 0xFF;
+        xor_bytes(out.data() + 2, out.data() + 2, cipher, size - 2);
+    }
+};
+
+#endif
@@ -0,0 +1,195 @@
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "fast-saes.hpp"
+#include "bitslice.hpp"
+#include "thread-pool.hpp"
+#include "util.hpp"
+#include "base64.hpp"
+
+using namespace std;
+
+#ifndef CFB_HPP
+#define CFB_HPP
+
+/**
+ * @class CFB
+ * @brief CFB (Cipher Feedback) mode encryption class for S-AES, with a full 16-bit feedback segment.
+ *
+ * @details C_i = P_i ⊕ E(C_{i-1}) with C_{-1} = IV, and P_i = C_i ⊕ E(C_{i-1}). Only the block
+ * encryption is used, and a final partial block is simply XORed with the start of its keystream
+ * block, so messages of any length are accepted without padding.
+ *
+ * Encryption is serial (the keystream needs the previous ciphertext). Decryption is not: the
+ * keystream of every block is the encryption of the previous ciphertext block, which is already
+ * known, so it is computed in bulk by the bitsliced engine, chunk by chunk on the thread pool
+ * when one is set, like CBC decryption.
+ *
+ * The span API keeps the feedback register between calls, so a message can be streamed in
+ * several chunks; every chunk but the last must then be a whole number of blocks.
+ */
+class CFB {
+public:
+
+    static const size_t ALIGNMENT = 1;          // Any length, the last block may be partial
+    static const size_t CHUNK_BLOCKS = 1 << 14; // 32 KiB per parallel task
+
+    int key;
+    int iv;
+
+    /**
+     * @brief Constructs a CFB mode encryption object.
+     *
+     * @param key_ The 16-bit key.
+     * @param iv_ The 16-bit initialization vector.
+     */
+    CFB(int key_, int iv_) : key(key_), iv(iv_), bitsliced(key_) {
+        FastSAES::expand_key((uint16_t)key, round_keys);
+        chain = (uint16_t)iv;
+    }
+
+    /**
+     * @brief Replaces the key and IV and restarts the feedback register.
+     */
+    void rekey(int key_, int iv_) {
+        key = key_;
+        bitsliced.rekey(key_);
+        FastSAES::expand_key((uint16_t)key, round_keys);
+        reset(iv_);
+    }
+
+    /**
+     * @brief Restarts the feedback register from a new IV (start of a new message).
+     */
+    void reset(int iv_) {
+        iv = iv_;
+        chain = (uint16_t)iv;
+    }
+
+    /**
+     * @brief Sets the number of threads used for decrypting large inputs (1: serial, 0: one per hardware thread).
+     */
+    void set_threads(int threads) {
+        pool = threads == 1 ? nullptr : make_shared<ThreadPool>(threads);
+    }
+
+    /**
+     * @brief Uses an existing thread pool (possibly shared with other modes), or nullptr for serial processing.
+     */
+    void set_pool(shared_ptr<ThreadPool> pool_) {
+        pool = pool_;
+    }
+
+    /**
+     * @brief Encrypts 'in' into 'out', continuing the current message. In-place allowed.
+     *
+     * @throws invalid_argument if the output is smaller than the input.
+     */
+    void encrypt(span<const uint8_t> in, span<uint8_t> out) {
+        Instrument::count_bytes(in.size());
+        Instrument::Timer timer(Instrument::CIPHER);
+        check_output(in, out);
+        size_t size = in.size(), whole = size & ~(size_t)1;
+        uint16_t previous = chain;
+        for(size_t i=0; i < whole; i += 2){
+            previous = FastSAES::encrypt(previous, round_keys) ^ (uint16_t)((in[i] << 8) | in[i + 1]);
+            out[i] = previous >> 8;
+            out[i + 1] = previous & 0xFF;
+        }
+        if(whole < size) out[whole] = in[whole] ^ (FastSAES::encrypt(previous, round_keys) >> 8);
+        chain = previous;
+    }
+
+    /**
+     * @brief Decrypts 'in' into 'out', continuing the current message. In-place allowed.
+     *
+     * @details Runs in parallel chunks when a thread pool is set and the input is large.
+     *
+     * @throws invalid_argument if the output is smaller than the input.
+     */
+    void decrypt(span<const uint8_t> in, span<uint8_t> out) {
+        Instrument::count_bytes(in.size());
+        Instrument::Timer timer(Instrument::CIPHER);
+        check_output(in, out);
+        size_t size = in.size(), blocks = (size + 1) / 2;
+        if(blocks == 0) return;
+
+        // Feedback value entering each chunk, read before any chunk may overwrite it (in-place)
+        size_t chunks = (blocks + CHUNK_BLOCKS - 1) / CHUNK_BLOCKS;
+        vector<uint16_t> entry(chunks);
+        entry[0] = chain;
+        for(size_t c=1; c < chunks; c++) entry[c] = read_block(in, c * CHUNK_BLOCKS - 1);
+        if(size % 2 == 0) chain = read_block(in, blocks - 1);
+
+        auto decrypt_chunks = [&](size_t begin, size_t end) {
+            vector<uint8_t> keystream(2 * min(CHUNK_BLOCKS, blocks));
+            for(size_t c=begin; c < end; c++){
+                size_t first = 2 * c * CHUNK_BLOCKS, length = min(2 * CHUNK_BLOCKS, size - first);
+                decrypt_chunk(in.subspan(first, length), out.subspan(first), entry[c], keystream.data());
+            }
+        };
+        if(pool && chunks > 1) pool->parallel_for(chunks, 1, decrypt_chunks);
+        else decrypt_chunks(0, chunks);
+    }
+
+    /**
+     * @brief Encrypts a complete plaintext string from the IV and returns the ciphertext in Base64.
+     */
+    string encrypt(const string& plainText) {
+        vector<uint8_t> bytes(plainText.begin(), plainText.end());
+        reset(iv);
+        encrypt(bytes, bytes);
+        return Base64::convert_to(bytes);
+    }
+
+    /**
+     * @brief Decrypts a complete Base64-encoded ciphertext from the IV and returns the plaintext.
+     */
+    string decrypt(const string& cipherText) {
+        string plainText(Base64::decoded_length(cipherText), '\0');
+        span<uint8_t> bytes((uint8_t*)plainText.data(), plainText.size());
+        Base64::decode(cipherText.data(), cipherText.size(), bytes.data());
+        reset(iv);
+        decrypt(bytes, bytes);
+        return plainText;
+    }
+
+private:
+
+    uint16_t round_keys[3];
+    uint16_t chain;             // Last ciphertext block (or IV) of the current message
+    BitslicedSAES bitsliced;
+    shared_ptr<ThreadPool> pool;
+
+    static void check_output(span<const uint8_t> in, span<uint8_t> out) {
+        if(out.size() < in.size()) throw invalid_argument("output buffer too small");
+    }
+
+    static uint16_t read_block(span<const uint8_t> bytes, size_t index) {
+        return (uint16_t)((bytes[2 * index] << 8) | bytes[2 * index + 1]);
+    }
+
+    // P_i = C_i ⊕ E(C_{i-1}) for one chunk; 'keystream' is scratch space for its blocks
+    void decrypt_chunk(span<const uint8_t> in, span<uint8_t> out, uint16_t previous, uint8_t* keystream) const {
+        size_t size = in.size(), blocks = (size + 1) / 2;
+        keystream[0] = previous >> 8;
+        keystream[1] = previous & 0xFF;
+        memcpy(keystream + 2, in.data(), 2 * (blocks - 1));
+        if(blocks >= BitslicedSAES::batch_blocks(bitsliced.isa)){
+            bitsliced.encrypt(keystream, keystream, blocks);
+        } else {
+            for(size_t i=0; i < 2 * blocks; i += 2){
+                uint16_t block = FastSAES::encrypt((uint16_t)((keystream[i] << 8) | keystream[i + 1]), round_keys);
+                keystream[i] = block >> 8;
+                keystream[i + 1] = block & 0xFF;
+            }
+        }
+        xor_bytes(out.data(), in.data(), keystream, size);
+    }
+};
+
+#endif
@@ -0,0 +1,442 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include <csignal>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ecb.hpp"
+#include "cbc.hpp"
+#include "cfb.hpp"
+#include "ofb.hpp"
+#include "ctr.hpp"
+#include "stream.hpp"
+#include "mapped-file.hpp"
+#include "output-file.hpp"
+#include "format.hpp"
+#include "key-search.hpp"
+#include "meet-in-the-middle.hpp"
+#include "cryptanalysis.hpp"
+#include "daemon.hpp"
+
+using namespace std;
+
+#ifndef CLI_HPP
+#define CLI_HPP
+
+/**
+ * @class CommandLine
+ * @brief Non-interactive entry point for scripts and pipelines.
+ *
+ * @details saes enc|dec [--mode ecb|cbc|cfb|ofb|ctr] --key HEX [--iv HEX] [--in FILE] [--out FILE]
+ *                       [--format raw|hex|b64] [--in-format F] [--out-format F] [--threads N]
+ *                       [--pad | --no-pad] [--nonce-bits N] [--chunk BYTES] [--profile FILE]
+ *          saes search --pair PLAIN:CIPHER [--pair PLAIN:CIPHER ...] [--threads N]
+ *          saes mitm --pair PLAIN:CIPHER [--pair PLAIN:CIPHER ...] [--threads N] [--stats]
+ *          saes analyze [--difference HEX] [--mask HEX] [--keys N|all] [--top N] [--threads N]
+ *          saes daemon --socket PATH [--cache-keys N] [--codebook-mib N] [--stats]
+ *
+ * Input and output default to stdin / stdout ("-"), used in binary mode through their file
+ * descriptors with 1 MiB chunks; nothing but errors is ever printed (on stderr). Raw regular
+ * files go through the memory-mapped path, everything else through the streaming one.
+ * A CTR message may not exceed the keystream of its key and nonce (512 bytes with the default
+ * 8-bit nonce, 128 KiB with --nonce-bits 0): longer inputs fail rather than reuse the keystream.
+ * The search command prints every key consistent with the known block pairs, one per line; mitm
+ * does the same for double S-AES (K1 K2 per line, --stats reports the attack phases on stderr).
+ * The analyze command prints the S-box difference and linear tables and, for an input difference
+ * or mask, the most likely output differences or masks of the full cipher over a set of keys.
+ * The daemon command serves framed requests on a Unix domain socket until SIGINT or SIGTERM
+ * (see Daemon and DaemonProtocol); --stats prints its counters on stderr when it stops.
+ * Every command accepts --profile FILE, which writes the counters and stage times of a build with
+ * -DSAES_INSTRUMENT=1 as JSON (FILE "-": a table on stderr) once the command is done.
+ * Exit status: 0 on success, 1 on a processing error (or no consistent key), 2 on a usage error.
+ */
+class CommandLine {
+public:
+
+    static int run(int argc, char** argv) {
+        Options options;
+        try {
+            options = parse(argc, argv);
+        } catch(const invalid_argument& e) {
+            fprintf(stderr, "saes: %s\n", e.what());
+            usage(stderr);
+            return 2;
+        }
+        if(options.help){
+            usage(stdout);
+            return 0;
+        }
+
+        int status = execute(options);
+        if(!options.profile.empty()) write_profile(options.profile);
+        return status;
+    }
+
+private:
+
+    struct Options {
+        bool help = false;
+        string command;
+        bool encrypt = true;
+        vector<KnownPair> pairs;
+        bool stats = false;
+        int difference = -1, mask = -1;
+        size_t keys = 256, top = 10;    // keys: 0 for all of them ("all")
+        string mode = "ecb";
+        int key = -1;
+        int iv = 0;
+        string in = "-", out = "-";
+        Format in_format = Format::RAW, out_format = Format::RAW;
+        int threads = 0;
+        int padding = -1;           // -1: the mode's default
+        int nonce_bits = 8;
+        size_t chunk = Stream::CHUNK_SIZE;
+        string socket;
+        size_t cache_keys = Daemon::CACHE_KEYS;
+        size_t codebook_mib = Daemon::CODEBOOK_BUDGET >> 20;
+        string profile;             // empty: no profile, "-": summary on stderr
+    };
+
+    static int execute(const Options& options) {
+        try {
+            if(options.command == "search") return search(options);
+            if(options.command == "mitm") return mitm(options);
+            if(options.command == "analyze") return analyze(options);
+            if(options.command == "daemon") return daemon(options);
+            if(options.mode == "ecb"){
+                ECB ecb(options.key, options.padding == 1);
+                return process(ecb, options);
+            }
+            if(options.mode == "cbc"){
+                CBC cbc(options.key, options.iv, options.padding != 0);
+                return process(cbc, options);
+            }
+            if(options.mode == "cfb"){
+                CFB cfb(options.key, options.iv);
+                return process(cfb, options);
+            }
+            if(options.mode == "ofb"){
+                OFB ofb(options.key, options.iv, true);
+                return process(ofb, options);
+            }
+            CTR ctr(options.key, options.iv, options.nonce_bits);
+            return process(ctr, options);
+        } catch(const exception& e) {
+            fprintf(stderr, "saes: %s\n", e.what());
+            return 1;
+        }
+    }
+
+    // Writes the instrumentation totals as JSON to 'path', or as a table on stderr for "-"
+    static void write_profile(const string& path) {
+        if(path == "-"){
+            fputs(Instrument::summary().c_str(), stderr);
+            return;
+        }
+        FILE* file = fopen(path.c_str(), "w");
+        if(!file){
+            fprintf(stderr, "saes: cannot open %s: %s\n", path.c_str(), strerror(errno));
+            return;
+        }
+        fputs(Instrument::json().c_str(), file);
+        fclose(file);
+    }
+
+    static void usage(FILE* to) {
+        fprintf(to,
+            "usage: saes enc|dec --key HEX [options]\n"
+            "  --mode ecb|cbc|cfb|ofb|ctr   mode of operation (default: ecb)\n"
+            "  --key HEX                    16-bit key\n"
+            "  --iv HEX                     16-bit IV (cbc, cfb, ofb) or nonce (ctr), default 0\n"
+            "  --in FILE, --out FILE        input / output files (default: - for stdin / stdout)\n"
+            "  --format raw|hex|b64         encoding of both input and output (default: raw)\n"
+            "  --in-format F, --out-format F  encoding of one side only\n"
+            "  --threads N                  threads for large inputs (default: 0, one per CPU)\n"
+            "  --pad, --no-pad              PKCS#7 padding, ecb and cbc only (default: on for cbc, off for ecb)\n"
+            "  --nonce-bits N               ctr: bits of the counter block taken by the nonce, 0-15 (default: 8);\n"
+            "                               a message is limited to 2^(17-N) bytes\n"
+            "  --chunk BYTES                streaming chunk size (default: 1 MiB)\n"
+            "  --profile FILE               any command: instrumentation counters as JSON (-: table on stderr)\n"
+            "  -h, --help                   show this help\n"
+            "usage: saes search|mitm --pair PLAIN:CIPHER [--pair ...] [--threads N] [--stats]\n"
+            "  --pair PLAIN:CIPHER          known 16-bit blocks (hex); more pairs rule out false positives\n"
+            "  --stats                      mitm: print the table size and phase times on stderr\n"
+            "usage: saes analyze [--difference HEX] [--mask HEX] [--keys N|all] [--top N] [--threads N]\n"
+            "  --difference HEX             full-cipher output differences for this input difference\n"
+            "  --mask HEX                   full-cipher linear potential of the output masks for this input mask\n"
+            "  --keys N|all                 keys covered by the full-cipher statistics (default: 256 sampled)\n"
+            "  --top N                      number of output differences / masks listed (default: 10)\n"
+            "usage: saes daemon --socket PATH [--cache-keys N] [--codebook-mib N] [--stats]\n"
+            "  --socket PATH                Unix domain socket to serve requests on\n"
+            "  --cache-keys N               keys whose schedule is cached (default: 256)\n"
+            "  --codebook-mib N             memory for the codebooks of hot keys, 256 KiB each (default: 64, 0: none)\n"
+            "  --stats                      print the request and cache counters on stderr when stopped\n");
+    }
+
+    static int parse_hex16(const string& text, const char* what) {
+        size_t end = 0;
+        unsigned long value = 0;
+        try {
+            value = stoul(text, &end, 16);
+        } catch(const exception&) {
+            end = 0;
+        }
+        if(end == 0 || end != text.size() || value > 0xFFFF)
+            throw invalid_argument(string("invalid ") + what + " (expected up to 4 hex digits): " + text);
+        return (int)value;
+    }
+
+    static KnownPair parse_pair(const string& text) {
+        size_t colon = text.find(':');
+        if(colon == string::npos) throw invalid_argument("invalid pair (expected PLAIN:CIPHER): " + text);
+        return {(uint16_t)parse_hex16(text.substr(0, colon), "plaintext"),
+                (uint16_t)parse_hex16(text.substr(colon + 1), "ciphertext")};
+    }
+
+    static long parse_number(const string& text, const char* what) {
+        size_t end = 0;
+        long value = -1;
+        try {
+            value = stol(text, &end, 10);
+        } catch(const exception&) {
+            end = 0;
+        }
+        if(end == 0 || end != text.size() || value < 0) throw invalid_argument(string("invalid ") + what + ": " + text);
+        return value;
+    }
+
+    static Options parse(int argc, char** argv) {
+        Options options;
+        int i = 1;
+        string command = argv[i++];
+        if(command == "-h" || command == "--help"){
+            options.help = true;
+            return options;
+        }
+        if(command != "enc" && command != "dec" && command != "search" && command != "mitm" && command != "analyze"
+           && command != "daemon")
+            throw invalid_argument("unknown command: " + command);
+        options.command = command;
+        options.encrypt = command == "enc";
+
+        for(; i < argc; i++){
+            string option = argv[i];
+            auto value = [&]() -> string {
+                if(i + 1 >= argc) throw invalid_argument("missing value for " + option);
+                return argv[++i];
+            };
+            if(option == "-h" || option == "--help") options.help = true;
+            else if(option == "--mode") options.mode = value();
+            else if(option == "--key") options.key = parse_hex16(value(), "key");
+            else if(option == "--iv" || option == "--nonce") options.iv = parse_hex16(value(), "IV");
+            else if(option == "--in") options.in = value();
+            else if(option == "--out") options.out = value();
+            else if(option == "--format") options.in_format = options.out_format = parse_format(value());
+            else if(option == "--in-format") options.in_format = parse_format(value());
+            else if(option == "--out-format") options.out_format = parse_format(value());
+            else if(option == "--threads") options.threads = (int)parse_number(value(), "thread count");
+            else if(option == "--pad") options.padding = 1;
+            else if(option == "--no-pad") options.padding = 0;
+            else if(option == "--nonce-bits") options.nonce_bits = (int)parse_number(value(), "nonce size");
+            else if(option == "--pair") options.pairs.push_back(parse_pair(value()));
+            else if(option == "--stats") options.stats = true;
+            else if(option == "--difference") options.difference = parse_hex16(value(), "difference");
+            else if(option == "--mask") options.mask = parse_hex16(value(), "mask");
+            else if(option == "--keys"){
+                string keys = value();
+                options.keys = keys == "all" ? 0 : (size_t)parse_number(keys, "key count");
+                if(options.keys == 0 && keys != "all") throw invalid_argument("--keys must be at least 1 (or all)");
+            }
+            else if(option == "--top") options.top = (size_t)parse_number(value(), "count");
+            else if(option == "--socket") options.socket = value();
+            else if(option == "--cache-keys") options.cache_keys = (size_t)parse_number(value(), "key count");
+            else if(option == "--codebook-mib") options.codebook_mib = (size_t)parse_number(value(), "codebook budget");
+            else if(option == "--profile") options.profile = value();
+            else if(option == "--chunk") options.chunk = (size_t)parse_number(value(), "chunk size");
+            else throw invalid_argument("unknown option: " + option);
+        }
+
+        if(options.help) return options;
+        if(options.command == "search" || options.command == "mitm"){
+            if(options.pairs.empty()) throw invalid_argument(options.command + " needs at least one --pair");
+            return options;
+        }
+        if(!options.pairs.empty()) throw invalid_argument("--pair is only used by search and mitm");
+        if(options.command == "daemon"){
+            if(options.socket.empty()) throw invalid_argument("daemon needs --socket");
+            return options;
+        }
+        if(options.command == "analyze"){
+            if(options.difference == 0 || options.mask == 0) throw invalid_argument("the difference and mask must be non-zero");
+            return options;
+        }
+        if(options.mode != "ecb" && options.mode != "cbc" && options.mode != "cfb" && options.mode != "ofb"
+           && options.mode != "ctr")
+            throw invalid_argument("unknown mode: " + options.mode);
+        if(options.key < 0) throw invalid_argument("--key is required");
+        if(options.padding != -1 && options.mode != "ecb" && options.mode != "cbc")
+            throw invalid_argument("--pad and --no-pad only apply to ecb and cbc (" + options.mode + " needs no padding)");
+        if(options.nonce_bits > 15) throw invalid_argument("the CTR nonce takes 0 to 15 bits");
+        if(options.mode == "ctr" && options.iv >= (1 << options.nonce_bits))
+            throw invalid_argument("the CTR nonce must fit in " + to_string(options.nonce_bits) + " bits");
+        return options;
+    }
+
+    template<class Cipher>
+    static int process(Cipher& cipher, const Options& options) {
+        if constexpr (requires { cipher.set_threads(1); }) cipher.set_threads(options.threads);
+
+        bool raw = options.in_format == Format::RAW && options.out_format == Format::RAW;
+        if(raw && options.in != "-" && options.out != "-" && MappedFile::is_regular(options.in)
+           && MappedFile::is_mappable_output(options.out)){
+            if(options.encrypt) MappedFile::encrypt(cipher, options.in, options.out);
+            else MappedFile::decrypt(cipher, options.in, options.out);
+            return 0;
+        }
+
+        int in_fd = options.in == "-" ? STDIN_FILENO : open_file(options.in, O_RDONLY);
+        try {
+            // Replacing the output would lose the input: refuse when they are the same file (also through a redirected stdin)
+            if(options.out != "-" && MappedFile::same_file(in_fd, options.out))
+                throw runtime_error("input and output must be different files");
+            // A regular output is only replaced once complete, so a failure leaves no partial or
+            // unverified output (e.g. decrypted bytes whose padding is invalid) and the old file intact
+            optional<OutputFile> output;
+            if(options.out != "-") output.emplace(options.out);
+            FormatReader reader(in_fd, options.in_format);
+            FormatWriter writer(output ? output->descriptor() : STDOUT_FILENO, options.out_format);
+            if(options.encrypt) Stream::encrypt(cipher, reader, writer, options.chunk);
+            else Stream::decrypt(cipher, reader, writer, options.chunk);
+            if(output) output->commit();
+        } catch(...) {
+            close_file(in_fd);
+            throw;
+        }
+        close_file(in_fd);
+        return 0;
+    }
+
+    static int search(const Options& options) {
+        KeySearch search;
+        if(options.threads != 1) search.set_threads(options.threads);
+        vector<uint16_t> keys = search.search(options.pairs);
+        if(keys.empty()){
+            fprintf(stderr, "saes: no key is consistent with the given pairs\n");
+            return 1;
+        }
+        for(uint16_t key : keys) printf("%04X\n", key);
+        return 0;
+    }
+
+    static int mitm(const Options& options) {
+        MeetInTheMiddle attack;
+        if(options.threads != 1) attack.set_threads(options.threads);
+        vector<uint32_t> keys = attack.attack(options.pairs);
+        if(options.stats){
+            const MeetInTheMiddle::Report& report = attack.last_report();
+            fprintf(stderr, "table: %zu KiB, candidates: %zu, forward: %.2f ms, backward: %.2f ms\n",
+                    report.table_bytes / 1024, report.candidates, report.forward_ms, report.backward_ms);
+        }
+        if(keys.empty()){
+            fprintf(stderr, "saes: no key pair is consistent with the given pairs\n");
+            return 1;
+        }
+        for(uint32_t key : keys) printf("%04X %04X\n", key >> 16, key & 0xFFFF);
+        return 0;
+    }
+
+    static inline atomic<Daemon*> running_daemon{nullptr};
+
+    static int daemon(const Options& options) {
+        Daemon daemon(options.socket, options.cache_keys, options.codebook_mib << 20);
+        running_daemon.store(&daemon);
+        auto stop = [](int) {
+            if(Daemon* d = running_daemon.load()) d->stop();
+        };
+        signal(SIGINT, stop);
+        signal(SIGTERM, stop);
+        daemon.run();
+        running_daemon.store(nullptr);
+        if(options.stats){
+            const Daemon::Stats& stats = daemon.stats();
+            const KeyCache& cache = daemon.key_cache();
+            CodebookCache::Stats codebooks = daemon.codebook_cache().stats();
+            fprintf(stderr, "connections %llu, requests %llu, batches %llu, batched blocks %llu\n"
+                            "key cache: %llu hits, %llu misses\n"
+                            "codebook cache: %llu hits, %llu built, %llu evicted, %zu of %zu kept\n",
+                    (unsigned long long)stats.connections, (unsigned long long)stats.requests,
+                    (unsigned long long)stats.batches, (unsigned long long)stats.batched_blocks,
+                    (unsigned long long)cache.hits, (unsigned long long)cache.misses,
+                    (unsigned long long)codebooks.hits, (unsigned long long)codebooks.misses,
+                    (unsigned long long)codebooks.evictions, codebooks.codebooks,
+                    daemon.codebook_cache().capacity());
+        }
+        return 0;
+    }
+
+    static int analyze(const Options& options) {
+        auto print_table = [](const char* title, const Cryptanalysis::Table& table) {
+            printf("%s\n     ", title);
+            for(int b=0; b < 16; b++) printf("%3X", b);
+            printf("\n");
+            for(int a=0; a < 16; a++){
+                printf("%3X  ", a);
+                for(int b=0; b < 16; b++) printf("%3d", table[a][b]);
+                printf("\n");
+            }
+            printf("\n");
+        };
+        Cryptanalysis::Table ddt = Cryptanalysis::difference_table(), lat = Cryptanalysis::linear_table();
+        print_table("S-box difference distribution table (input difference → output difference)", ddt);
+        print_table("S-box linear approximation table (input mask → output mask, count − 8)", lat);
+        printf("Differential uniformity: %d/16, linearity: %d/16, MixColumns branch number: %d\n",
+               Cryptanalysis::differential_uniformity(ddt), Cryptanalysis::linearity(lat), Cryptanalysis::branch_number());
+        if(options.difference < 0 && options.mask < 0) return 0;
+
+        Cryptanalysis analysis;
+        if(options.threads != 1) analysis.set_threads(options.threads);
+        vector<uint16_t> keys = options.keys == 0 ? Cryptanalysis::all_keys() : Cryptanalysis::sample_keys(options.keys);
+        vector<uint32_t> order(Cryptanalysis::BLOCKS);
+        auto top = [&](const auto& values) {
+            for(uint32_t i=0; i < order.size(); i++) order[i] = i;
+            size_t count = min(options.top, order.size());
+            partial_sort(order.begin(), order.begin() + count, order.end(), [&](uint32_t a, uint32_t b) {
+                return values[a] > values[b];
+            });
+            return count;
+        };
+
+        if(options.difference >= 0){
+            vector<uint64_t> counts = analysis.differential((uint16_t)options.difference, keys);
+            double total = (double)Cryptanalysis::BLOCKS * keys.size();
+            printf("\nOutput differences for input difference %04X over %zu keys\n", options.difference, keys.size());
+            for(size_t i=0, n=top(counts); i < n; i++) printf("%04X  %.6f\n", order[i], counts[order[i]] / total);
+        }
+        if(options.mask >= 0){
+            vector<double> potential = analysis.linear((uint16_t)options.mask, keys);
+            printf("\nOutput masks for input mask %04X over %zu keys (expected linear potential)\n", options.mask, keys.size());
+            for(size_t i=0, n=top(potential); i < n; i++) printf("%04X  %.6f\n", order[i], potential[order[i]]);
+        }
+        return 0;
+    }
+
+    static int open_file(const string& path, int flags) {
+        int fd = ::open(path.c_str(), flags, 0644);
+        if(fd < 0) throw runtime_error("cannot open " + path + ": " + strerror(errno));
+        return fd;
+    }
+
+    static void close_file(int fd) {
+        if(fd != STDIN_FILENO && fd != STDOUT_FILENO) ::close(fd);
+    }
+};
+
+#endif
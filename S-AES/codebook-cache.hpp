@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "codebook.hpp"
+
+using namespace std;
+
+#ifndef CODEBOOK_CACHE_HPP
+#define CODEBOOK_CACHE_HPP
+
+/**
+ * @class CodebookCache
+ * @brief Key-indexed LRU cache of codebooks under a memory budget, shared by concurrent threads.
+ *
+ * @details get() returns the codebook of a key, building it on first use (65,536 encryptions) and
+ * keeping it while it is among the most recently used ones that fit in the budget; at 256 KiB per
+ * key, a budget of 64 MiB holds the 256 hottest keys. The keys are spread over up to 16 shards,
+ * each with its own lock, LRU list and share of the budget, so concurrent readers of different
+ * keys seldom contend and a hit only holds its shard's lock for a lookup and a list splice.
+ * Codebooks are built outside the lock; when two threads miss on the same key at once, both
+ * build it and the first one inserted is kept.
+ *
+ * Codebooks are handed out as shared pointers: an evicted codebook stays valid for the readers
+ * still holding it, and its memory is released by the last of them (the budget bounds what the
+ * cache itself keeps).
+ */
+class CodebookCache {
+public:
+
+    static const size_t MAX_SHARDS = 16;
+    static const size_t CODEBOOK_BYTES = 2 * Codebook::BLOCKS * sizeof(uint16_t);  // 256 KiB
+
+    /**
+     * @brief Counters summed over the shards.
+     */
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;        // Codebooks built
+        uint64_t evictions = 0;
+        size_t codebooks = 0;       // Codebooks currently cached
+    };
+
+    /**
+     * @brief Constructs an empty cache.
+     *
+     * @param budget_bytes Memory the cached codebooks may use (at least one codebook is kept).
+     */
+    CodebookCache(size_t budget_bytes = 64 << 20) {
+        size_t capacity = max<size_t>(1, budget_bytes / CODEBOOK_BYTES);
+        shards = vector<Shard>(min(MAX_SHARDS, capacity));
+        for(size_t s=0; s < shards.size(); s++) shards[s].capacity = capacity / shards.size() + (s < capacity % shards.size());
+    }
+
+    /**
+     * @brief Returns the codebook of a key, building and caching it on a miss.
+     */
+    shared_ptr<const Codebook> get(uint16_t key) {
+        Shard& shard = shard_of(key);
+        if(shared_ptr<const Codebook> codebook = lookup(shard, key)) return codebook;
+
+        auto built = make_shared<const Codebook>(key);
+        lock_guard<mutex> lock(shard.lock);
+        shard.misses++;
+        auto it = shard.entries.find(key);
+        if(it != shard.entries.end()) return it->second.codebook;   // Built concurrently by another thread
+        if(shard.entries.size() >= shard.capacity){
+            shard.entries.erase(shard.order.back());
+            shard.order.pop_back();
+            shard.evictions++;
+        }
+        shard.order.push_front(key);
+        shard.entries.emplace(key, Entry{built, shard.order.begin()});
+        return built;
+    }
+
+    /**
+     * @brief Returns the codebook of a key if it is cached, nullptr otherwise (nothing is built).
+     */
+    shared_ptr<const Codebook> find(uint16_t key) {
+        return lookup(shard_of(key), key);
+    }
+
+    /**
+     * @brief Returns the number of codebooks the budget allows.
+     */
+    size_t capacity() const {
+        size_t total = 0;
+        for(const Shard& shard : shards) total += shard.capacity;
+        return total;
+    }
+
+    /**
+     * @brief Returns the counters of all the shards.
+     */
+    Stats stats() const {
+        Stats total;
+        for(const Shard& shard : shards){
+            lock_guard<mutex> lock(shard.lock);
+            total.hits += shard.hits;
+            total.misses += shard.misses;
+            total.evictions += shard.evictions;
+            total.codebooks += shard.entries.size();
+        }
+        return total;
+    }
+
+    /**
+     * @brief Drops every cached codebook (those still held by readers stay valid).
+     */
+    void clear() {
+        for(Shard& shard : shards){
+            lock_guard<mutex> lock(shard.lock);
+            shard.entries.clear();
+            shard.order.clear();
+        }
+    }
+
+private:
+
+    struct Entry {
+        shared_ptr<const Codebook> codebook;
+        list<uint16_t>::iterator position;  // In the shard's LRU order
+    };
+
+    struct Shard {
+        mutable mutex lock;
+        size_t capacity = 1;
+        list<uint16_t> order;               // Most recently used first
+        unordered_map<uint16_t, Entry> entries;
+        uint64_t hits = 0, misses = 0, evictions = 0;
+    };
+
+    vector<Shard> shards;
+
+    // Neighbouring keys go to different shards
+    Shard& shard_of(uint16_t key) {
+        return shards[key % shards.size()];
+    }
+
+    shared_ptr<const Codebook> lookup(Shard& shard, uint16_t key) {
+        lock_guard<mutex> lock(shard.lock);
+        auto it = shard.entries.find(key);
+        if(it == shard.entries.end()) return nullptr;
+        shard.order.splice(shard.order.begin(), shard.order, it->second.position);
+        shard.hits++;
+        return it->second.codebook;
+    }
+};
+
+#endif
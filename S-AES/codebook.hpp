@@ -0,0 +1,75 @@
+#include <cstdint>
+#include <vector>
+
+#include "fast-saes.hpp"
+
+using namespace std;
+
+#ifndef CODEBOOK_HPP
+#define CODEBOOK_HPP
+
+/**
+ * @class Codebook
+ * @brief Precomputed encryption and decryption tables of S-AES for a single key.
+ *
+ * @details S-AES has a 16-bit block, so for a fixed key the whole cipher is a permutation
+ * of only 65,536 values. This class materializes that permutation (and its inverse) once,
+ * on construction, turning every block operation into a single table load.
+ * The tables are filled with the allocation-free FastSAES round functions; the round-by-round
+ * SAES class remains the reference implementation.
+ *
+ * Memory footprint: 2 tables × 65,536 entries × 2 bytes = 256 KiB per key.
+ */
+class Codebook {
+public:
+
+    static const int BLOCKS = 1 << 16;
+
+    int key;
+
+    /**
+     * @brief Builds the encryption and decryption tables for the given key.
+     *
+     * @details The key is expanded once and every one of the 65,536 plaintext blocks is encrypted
+     * once; the decryption table is obtained by inverting the encryption permutation,
+     * so no decryption has to be computed.
+     *
+     * @param key_ The 16-bit encryption key.
+     */
+    Codebook(int key_) : key(key_), enc_table(BLOCKS), dec_table(BLOCKS) {
+        uint16_t round_keys[3];
+        FastSAES::expand_key((uint16_t)key, round_keys);
+        for(int block=0; block < BLOCKS; block++){
+            uint16_t cipher = FastSAES::encrypt((uint16_t)block, round_keys);
+            enc_table[block] = cipher;
+            dec_table[cipher] = (uint16_t)block;
+        }
+    }
+
+    /**
+     * @brief Encrypts a 16-bit block with a single table lookup.
+     *
+     * @param block The 16-bit plaintext block.
+     * @return The 16-bit ciphertext block.
+     */
+    uint16_t encrypt(uint16_t block) const {
+        return enc_table[block];
+    }
+
+    /**
+     * @brief Decrypts a 16-bit block with a single table lookup.
+     *
+     * @param block The 16-bit ciphertext block.
+     * @return The 16-bit plaintext block.
+     */
+    uint16_t decrypt(uint16_t block) const {
+        return dec_table[block];
+    }
+
+private:
+
+    vector<uint16_t> enc_table; // enc_table[plaintext]  = ciphertext
+    vector<uint16_t> dec_table; // dec_table[ciphertext] = plaintext
+};
+
+#endif
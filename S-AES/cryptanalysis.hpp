@@ -0,0 +1,273 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <span>
+#include <vector>
+
+#include "gf16.hpp"
+#include "fast-saes.hpp"
+#include "bitslice.hpp"
+#include "thread-pool.hpp"
+#include "util.hpp"
+
+using namespace std;
+
+#ifndef CRYPTANALYSIS_HPP
+#define CRYPTANALYSIS_HPP
+
+/**
+ * @class Cryptanalysis
+ * @brief Differential and linear statistics of the S-AES S-box, MixColumns and full cipher.
+ *
+ * @details Component tables are computed from the S-box used by SAES::apply_sbox (FastSAES::SBOX)
+ * and the MixColumns matrices (SAES_MIX):
+ * - DDT[a][b] = #{x : S(x) ⊕ S(x ⊕ a) = b}
+ * - LAT[a][b] = #{x : a·x = b·S(x)} − 8, the bias times 16
+ * - the branch number of MixColumns over one column
+ *
+ * Full-cipher statistics cover all 2¹⁶ plaintexts of each key of a set (all keys or a sample).
+ * Each key's codebook is produced in one pass of the bitsliced engine, then:
+ * - differential(): histogram of E(P) ⊕ E(P ⊕ Δ) over every output difference,
+ * - linear(): squared correlation of α·P ⊕ β·E(P) for every output mask β at once, with a
+ *   fast Walsh-Hadamard transform (butterflies on vectors of 8 coefficients),
+ * averaged over the keys. With a thread pool the keys are split into one range per thread,
+ * each accumulating into its own histogram; the histograms are merged at the end.
+ * All 2³² encryptions of a full-key statistic take seconds per thread.
+ */
+class Cryptanalysis {
+public:
+
+    typedef array<array<int, 16>, 16> Table;
+
+    static const uint32_t BLOCKS = 1 << 16;
+
+    /**
+     * @brief Computes the difference distribution table of the (inverse) S-box.
+     *
+     * @param inverse Uses the decryption S-box when true.
+     * @return DDT[a][b]: number of inputs x with S(x) ⊕ S(x ⊕ a) = b.
+     */
+    static Table difference_table(bool inverse = false) {
+        Table ddt{};
+        for(int a=0; a < 16; a++){
+            for(int x=0; x < 16; x++) ddt[a][FastSAES::SBOX[inverse][x] ^ FastSAES::SBOX[inverse][x ^ a]]++;
+        }
+        return ddt;
+    }
+
+    /**
+     * @brief Computes the linear approximation table of the (inverse) S-box.
+     *
+     * @param inverse Uses the decryption S-box when true.
+     * @return LAT[a][b]: number of inputs x with a·x = b·S(x), minus 8.
+     */
+    static Table linear_table(bool inverse = false) {
+        Table lat{};
+        for(int a=0; a < 16; a++){
+            for(int b=0; b < 16; b++){
+                for(int x=0; x < 16; x++) lat[a][b] += parity(a & x) == parity(b & FastSAES::SBOX[inverse][x]);
+                lat[a][b] -= 8;
+            }
+        }
+        return lat;
+    }
+
+    /**
+     * @brief Returns the largest DDT entry for a non-zero input difference (4 for S-AES).
+     */
+    static int differential_uniformity(const Table& ddt) {
+        int best = 0;
+        for(int a=1; a < 16; a++){
+            for(int b=0; b < 16; b++) best = max(best, ddt[a][b]);
+        }
+        return best;
+    }
+
+    /**
+     * @brief Returns the largest absolute LAT entry for a non-zero output mask.
+     */
+    static int linearity(const Table& lat) {
+        int best = 0;
+        for(int a=0; a < 16; a++){
+            for(int b=1; b < 16; b++) best = max(best, abs(lat[a][b]));
+        }
+        return best;
+    }
+
+    /**
+     * @brief Returns the branch number of MixColumns: the fewest active nibbles at its input and
+     * output together, over all non-zero columns (3 for the S-AES matrix, the maximum for 2×2).
+     *
+     * @param inverse Uses the decryption matrix when true.
+     */
+    static int branch_number(bool inverse = false) {
+        auto active = [](int column) { return ((column >> 4) != 0) + ((column & 0xF) != 0); };
+        int best = 4;
+        for(int column=1; column < 256; column++){
+            best = min(best, active(column) + active(SAES_MIX_COLUMN[inverse][column]));
+        }
+        return best;
+    }
+
+    /**
+     * @brief Returns the 65,536 keys in increasing order.
+     */
+    static vector<uint16_t> all_keys() {
+        vector<uint16_t> keys(BLOCKS);
+        for(uint32_t k=0; k < BLOCKS; k++) keys[k] = (uint16_t)k;
+        return keys;
+    }
+
+    /**
+     * @brief Returns 'count' distinct keys drawn uniformly (all keys if count ≥ 65,536).
+     */
+    static vector<uint16_t> sample_keys(size_t count, uint32_t seed = 1) {
+        vector<uint16_t> keys = all_keys();
+        if(count >= keys.size()) return keys;
+        mt19937 rng(seed);
+        for(size_t i=0; i < count; i++) swap(keys[i], keys[i + rng() % (keys.size() - i)]);
+        keys.resize(count);
+        sort(keys.begin(), keys.end());
+        return keys;
+    }
+
+    /**
+     * @brief Sets the number of threads used by the full-cipher statistics.
+     *
+     * @param threads Total number of threads (1: serial, 0: one per hardware thread).
+     */
+    void set_threads(int threads) {
+        pool = threads == 1 ? nullptr : make_shared<ThreadPool>(threads);
+    }
+
+    /**
+     * @brief Uses an existing thread pool (possibly shared with the modes of operation).
+     *
+     * @param pool_ The pool, or nullptr for serial computations.
+     */
+    void set_pool(shared_ptr<ThreadPool> pool_) {
+        pool = pool_;
+    }
+
+    /**
+     * @brief Counts the output differences of the full cipher for one input difference.
+     *
+     * @param delta The input difference Δ (non-zero).
+     * @param keys The keys to cover.
+     * @return counts[d]: number of (key, plaintext P) with E(P) ⊕ E(P ⊕ Δ) = d; dividing by
+     * 2¹⁶ · keys.size() gives the expected differential probability.
+     */
+    vector<uint64_t> differential(uint16_t delta, span<const uint16_t> keys) {
+        return sum_over_keys<uint64_t>(keys, [&](const uint16_t* codebook, vector<uint64_t>& counts) {
+            for(uint32_t p=0; p < BLOCKS; p++) counts[codebook[p] ^ codebook[p ^ delta]]++;
+        });
+    }
+
+    /**
+     * @brief Computes the expected linear potential of the full cipher for one input mask and
+     * every output mask.
+     *
+     * @param alpha The input mask α (non-zero).
+     * @param keys The keys to cover.
+     * @return potential[β]: average over the keys of the squared correlation of α·P ⊕ β·E(P).
+     */
+    vector<double> linear(uint16_t alpha, span<const uint16_t> keys) {
+        // Sums of squared Walsh coefficients, exact in 64 bits (each one is at most 2³²)
+        vector<uint64_t> squares = sum_over_keys<uint64_t>(keys, [&](const uint16_t* codebook, vector<uint64_t>& sum) {
+            // w[E(P)] = (-1)^(α·P), transformed into Σ_y w[y]·(-1)^(β·y) for every β
+            thread_local vector<int32_t> w(BLOCKS);
+            for(uint32_t p=0; p < BLOCKS; p++) w[codebook[p]] = 1 - 2 * parity(alpha & p);
+            walsh_hadamard(w.data());
+            for(uint32_t b=0; b < BLOCKS; b++) sum[b] += (uint64_t)((int64_t)w[b] * w[b]);
+        });
+        vector<double> potential(BLOCKS);
+        double scale = (double)BLOCKS * BLOCKS * (double)max<size_t>(keys.size(), 1);
+        for(uint32_t b=0; b < BLOCKS; b++) potential[b] = squares[b] / scale;
+        return potential;
+    }
+
+private:
+
+    shared_ptr<ThreadPool> pool; // nullptr: serial computations
+
+    static int parity(uint32_t x) {
+        return __builtin_parity(x);
+    }
+
+    typedef int32_t i32x8 __attribute__((vector_size(32)));
+
+    /*  In-place fast Walsh-Hadamard transform of 65,536 values. The three first butterfly stages
+        stay within groups of 8 values; the 13 others combine whole vectors of 8 values.
+    */
+    SAES_VECTOR_CLONES static void walsh_hadamard(int32_t* w) {
+        for(uint32_t group=0; group < BLOCKS; group += 8){
+            int32_t* x = w + group;
+            for(int half=1; half < 8; half <<= 1){
+                for(int block=0; block < 8; block += 2 * half){
+                    for(int i=block; i < block + half; i++){
+                        int32_t a = x[i], b = x[i + half];
+                        x[i] = a + b;
+                        x[i + half] = a - b;
+                    }
+                }
+            }
+        }
+        for(uint32_t half=8; half < BLOCKS; half <<= 1){
+            for(uint32_t block=0; block < BLOCKS; block += 2 * half){
+                for(uint32_t i=block; i < block + half; i += 8){
+                    i32x8 a, b;
+                    memcpy(&a, w + i, sizeof(a));
+                    memcpy(&b, w + i + half, sizeof(b));
+                    i32x8 sum = a + b, difference = a - b;
+                    memcpy(w + i, &sum, sizeof(sum));
+                    memcpy(w + i + half, &difference, sizeof(difference));
+                }
+            }
+        }
+    }
+
+    /*  Runs 'add(codebook, histogram)' for the codebook of every key, the keys being split into one
+        range per thread with its own zeroed histogram of 65,536 entries; returns the merged sum.
+    */
+    template<class T>
+    vector<T> sum_over_keys(span<const uint16_t> keys, const function<void(const uint16_t*, vector<T>&)>& add) {
+        size_t ranges = pool ? (size_t)pool->size() : 1;
+        ranges = max<size_t>(1, min(ranges, keys.size()));
+        vector<vector<T>> histograms(ranges, vector<T>(BLOCKS, 0));
+
+        auto run = [&](size_t begin, size_t end) {
+            // Blocks 0..65535 in big-endian order: one bitsliced pass gives the codebook of a key
+            vector<uint8_t> identity(2 * BLOCKS), encrypted(2 * BLOCKS);
+            vector<uint16_t> codebook(BLOCKS);
+            for(uint32_t p=0; p < BLOCKS; p++){
+                identity[2 * p] = (uint8_t)(p >> 8);
+                identity[2 * p + 1] = (uint8_t)p;
+            }
+            BitslicedSAES engine(0);
+            for(size_t range=begin; range < end; range++){
+                for(size_t i = keys.size() * range / ranges; i < keys.size() * (range + 1) / ranges; i++){
+                    engine.rekey(keys[i]);
+                    engine.encrypt(identity.data(), encrypted.data(), BLOCKS);
+                    for(uint32_t p=0; p < BLOCKS; p++){
+                        codebook[p] = (uint16_t)((encrypted[2 * p] << 8) | encrypted[2 * p + 1]);
+                    }
+                    add(codebook.data(), histograms[range]);
+                }
+            }
+        };
+        if(pool) pool->parallel_for(ranges, 1, run);
+        else run(0, ranges);
+
+        for(size_t range=1; range < ranges; range++){
+            for(uint32_t i=0; i < BLOCKS; i++) histograms[0][i] += histograms[range][i];
+        }
+        return histograms[0];
+    }
+};
+
+#endif
@@ -0,0 +1,234 @@
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bitslice.hpp"
+#include "thread-pool.hpp"
+#include "util.hpp"
+#include "base64.hpp"
+
+using namespace std;
+
+#ifndef CTR_HPP
+#define CTR_HPP
+
+/**
+ * @class CTR
+ * @brief CTR (Counter) mode encryption class for S-AES.
+ *
+ * @details The i-th keystream block is the encryption of the 16-bit counter block nonce ‖ i, where
+ * the nonce takes the 'nonce_bits' most significant bits and the counter the remaining ones.
+ * Ciphertext = plaintext ⊕ keystream, so encryption and decryption are the same operation and
+ * inputs of any length up to the period are accepted.
+ *
+ * With a 16-bit block a key and nonce only have 2^(16 - nonce_bits) counter blocks, i.e.
+ * period() = 2^(17 - nonce_bits) bytes of keystream (512 bytes with the default 8-bit nonce,
+ * 128 KiB at most). Wrapping the counter would reuse the keystream and leak the XOR of the
+ * plaintexts, so processing past the period throws; nonce_bits_for() gives the nonce size a
+ * message needs. The whole period is generated once per key/nonce (with the bitsliced engine,
+ * in parallel when a thread pool is set), which gives:
+ * - random access: the keystream byte for any offset is keystream[offset], without processing
+ *   the previous blocks (see crypt_at / seek);
+ * - no dependency between blocks: large inputs are XORed in parallel chunks.
+ *
+ * encrypt/decrypt(span, span) continue from the current position (as a stream), so a message can
+ * be processed in several calls; the string API always starts at offset 0.
+ */
+class CTR {
+public:
+
+    static const size_t ALIGNMENT = 1;          // Any length, CTR is a stream mode
+    static const size_t CHUNK_BYTES = 1 << 15;  // 32 KiB per parallel task
+
+    int key;
+    int nonce;
+    int nonce_bits;
+
+    /**
+     * @brief Constructs a CTR mode encryption object.
+     *
+     * @param key_ The 16-bit key.
+     * @param nonce_ The nonce, placed in the high bits of every counter block.
+     * @param nonce_bits_ Number of bits of the counter block taken by the nonce (0 to 15, default 8).
+     * @param pool_ Optional thread pool for keystream generation and large inputs.
+     * @throws invalid_argument if nonce_bits_ is out of range or the nonce does not fit in it.
+     */
+    CTR(int key_, int nonce_ = 0, int nonce_bits_ = 8, shared_ptr<ThreadPool> pool_ = nullptr)
+        : key(key_), nonce(nonce_), nonce_bits(nonce_bits_), pool(pool_), bitsliced(key_) {
+        if(nonce_bits < 0 || nonce_bits > 15) throw invalid_argument("the CTR nonce takes 0 to 15 bits");
+        check_nonce(nonce);
+        generate_keystream();
+    }
+
+    /**
+     * @brief Returns the largest nonce size, up to the default 8 bits, whose counter covers a
+     * message of 'bytes' bytes.
+     *
+     * @throws invalid_argument if the message is longer than 128 KiB, the keystream of a key.
+     */
+    static int nonce_bits_for(uint64_t bytes) {
+        uint64_t blocks = (bytes + 1) / 2;
+        int counter_bits = 8;
+        while(counter_bits < 16 && (1ULL << counter_bits) < blocks) counter_bits++;
+        if((1ULL << counter_bits) < blocks) throw invalid_argument("CTR messages are limited to 128 KiB per key");
+        return 16 - counter_bits;
+    }
+
+    /**
+     * @brief Replaces the key and nonce and regenerates the keystream period.
+     *
+     * @throws invalid_argument if the nonce does not fit in nonce_bits.
+     */
+    void rekey(int key_, int nonce_) {
+        check_nonce(nonce_);
+        key = key_;
+        nonce = nonce_;
+        bitsliced.rekey(key_);
+        generate_keystream();
+        position = 0;
+    }
+
+    /**
+     * @brief Sets the number of threads used for large inputs (1: serial, 0: one per hardware thread).
+     */
+    void set_threads(int threads) {
+        pool = threads == 1 ? nullptr : make_shared<ThreadPool>(threads);
+    }
+
+    /**
+     * @brief Uses an existing thread pool (possibly shared with other modes), or nullptr for serial processing.
+     */
+    void set_pool(shared_ptr<ThreadPool> pool_) {
+        pool = pool_;
+    }
+
+    /**
+     * @brief Returns the counter block of the i-th keystream block.
+     */
+    uint16_t counter_block(uint64_t block_index) const {
+        int counter_bits = 16 - nonce_bits;
+        uint64_t counter_mask = (1ULL << counter_bits) - 1;
+        return (uint16_t)(((uint64_t)nonce << counter_bits) | (block_index & counter_mask));
+    }
+
+    /**
+     * @brief Returns the number of keystream bytes of a key and nonce, the maximum message length.
+     */
+    uint64_t period() const {
+        return keystream.size();
+    }
+
+    /**
+     * @brief Moves the stream position used by encrypt/decrypt to an arbitrary byte offset.
+     */
+    void seek(uint64_t offset) {
+        position = offset;
+    }
+
+    /**
+     * @brief Returns the current stream position in bytes.
+     */
+    uint64_t tell() const {
+        return position;
+    }
+
+    /**
+     * @brief Encrypts (XORs with the keystream) 'in' into 'out' starting at byte 'offset' of the message.
+     *
+     * @details Stateless random access: only the requested bytes are processed. In-place allowed.
+     *
+     * @param in The input bytes.
+     * @param out The destination, at least in.size() bytes.
+     * @param offset Position of in[0] in the message.
+     * @throws invalid_argument if the output is smaller than the input, or the bytes extend past
+     * period() (the keystream would repeat).
+     */
+    void crypt_at(span<const uint8_t> in, span<uint8_t> out, uint64_t offset) const {
+        if(out.size() < in.size()) throw invalid_argument("output buffer too small");
+        if(offset > keystream.size() || in.size() > keystream.size() - offset)
+            throw invalid_argument("CTR keystream exhausted: with a nonce of " + to_string(nonce_bits) + " bits, a message is limited to "
+                                   + to_string(keystream.size()) + " bytes");
+        if(!pool || in.size() < 2 * CHUNK_BYTES) {
+            xor_keystream(in.data(), out.data(), in.size(), offset);
+            return;
+        }
+        pool->parallel_for(in.size(), CHUNK_BYTES, [&](size_t begin, size_t end) {
+            xor_keystream(in.data() + begin, out.data() + begin, end - begin, offset + begin);
+        });
+    }
+
+    /**
+     * @brief Encrypts 'in' into 'out' from the current position, then advances it.
+     */
+    void encrypt(span<const uint8_t> in, span<uint8_t> out) {
+        Instrument::count_bytes(in.size());
+        Instrument::Timer timer(Instrument::CIPHER);
+        crypt_at(in, out, position);
+        position += in.size();
+    }
+
+    /**
+     * @brief Decrypts 'in' into 'out' from the current position, then advances it (same as encrypt).
+     */
+    void decrypt(span<const uint8_t> in, span<uint8_t> out) {
+        encrypt(in, out);
+    }
+
+    /**
+     * @brief Encrypts a plaintext string (from offset 0) and returns the ciphertext in Base64.
+     */
+    string encrypt(const string& plainText) const {
+        vector<uint8_t> bytes(plainText.begin(), plainText.end());
+        crypt_at(bytes, bytes, 0);
+        return Base64::convert_to(bytes);
+    }
+
+    /**
+     * @brief Decrypts a Base64-encoded ciphertext (from offset 0) and returns the plaintext.
+     */
+    string decrypt(const string& cipherText) const {
+        string plainText(Base64::decoded_length(cipherText), '\0');
+        span<uint8_t> bytes((uint8_t*)plainText.data(), plainText.size());
+        Base64::decode(cipherText.data(), cipherText.size(), bytes.data());
+        crypt_at(bytes, bytes, 0);
+        return plainText;
+    }
+
+private:
+
+    shared_ptr<ThreadPool> pool;
+    BitslicedSAES bitsliced;
+    vector<uint8_t> keystream; // One full period of keystream bytes
+    uint64_t position = 0;
+
+    // Encrypts the counter blocks of one full period
+    void generate_keystream() {
+        size_t blocks = (size_t)1 << (16 - nonce_bits);
+        keystream.resize(2 * blocks);
+        for(size_t i=0; i < blocks; i++){
+            uint16_t counter = counter_block(i);
+            keystream[2 * i] = counter >> 8;
+            keystream[2 * i + 1] = counter & 0xFF;
+        }
+        auto encrypt_range = [&](size_t begin, size_t end) {
+            bitsliced.encrypt(keystream.data() + 2 * begin, keystream.data() + 2 * begin, end - begin);
+        };
+        if(pool) pool->parallel_for(blocks, CHUNK_BYTES / 2, encrypt_range);
+        else encrypt_range(0, blocks);
+    }
+
+    void check_nonce(int nonce_) const {
+        if(nonce_ < 0 || nonce_ >= (1 << nonce_bits))
+            throw invalid_argument("the CTR nonce must fit in " + to_string(nonce_bits) + " bits");
+    }
+
+    // out = in ⊕ keystream, for 'size' bytes starting at message offset 'offset' (within the period)
+    void xor_keystream(const uint8_t* in, uint8_t* out, size_t size, uint64_t offset) const {
+        xor_bytes(out, in, keystream.data() + offset, size);
+    }
+};
+
+#endif
@@ -0,0 +1,792 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "fast-saes.hpp"
+#include "bitslice.hpp"
+#include "codebook-cache.hpp"
+#include "ctr.hpp"
+#include "padding.hpp"
+#include "util.hpp"
+
+using namespace std;
+
+#ifndef DAEMON_HPP
+#define DAEMON_HPP
+
+/**
+ * @brief Wire format shared by Daemon and DaemonClient.
+ *
+ * @details Every message is a frame: a 32-bit length (of the rest of the frame) followed by the
+ * body. All integers are big-endian.
+ * - Request body: id (32 bits), op (8: 0 encrypt, 1 decrypt), mode (8: 0 ECB, 1 CBC, 2 CFB,
+ *   3 OFB, 4 CTR), flags (8: bit 0 = PKCS#7 padding, ECB and CBC only), reserved (8), key (16),
+ *   IV or CTR nonce (16), then the payload.
+ * - Response body: the request id (32 bits), status (8: 0 OK, 1 error), then the output bytes,
+ *   or an error message.
+ *
+ * The modes match the ECB, CBC, CFB, OFB and CTR classes, each message starting from the IV.
+ * CTR messages are limited to 128 KiB and their counter starts from 0; the nonce takes
+ * CTR::nonce_bits_for(length) bits: 8 up to 512 bytes, one less each time the length doubles.
+ */
+struct DaemonProtocol {
+    enum Op : uint8_t { ENCRYPT = 0, DECRYPT = 1 };
+    enum class Mode : uint8_t { ECB = 0, CBC = 1, CFB = 2, OFB = 3, CTR = 4 };
+    enum Status : uint8_t { OK = 0, ERROR = 1 };
+
+    static const uint8_t PAD = 1;                       // Flag: PKCS#7 padding
+    static const size_t REQUEST_HEADER = 12;            // Request body bytes before the payload
+    static const size_t RESPONSE_HEADER = 5;            // Response body bytes before the output
+    static const size_t MAX_PAYLOAD = 1 << 24;          // 16 MiB per request
+
+    static void put16(uint8_t* p, uint16_t v) { p[0] = v >> 8; p[1] = v & 0xFF; }
+    static void put32(uint8_t* p, uint32_t v) { put16(p, v >> 16); put16(p + 2, v & 0xFFFF); }
+    static uint16_t get16(const uint8_t* p) { return (uint16_t)((p[0] << 8) | p[1]); }
+    static uint32_t get32(const uint8_t* p) { return ((uint32_t)get16(p) << 16) | get16(p + 2); }
+};
+
+/**
+ * @class KeyCache
+ * @brief LRU cache of per-key state for the daemon: round-key schedule and hotness.
+ *
+ * @details Keys index a flat array of 65,536 slot numbers and the entries form an intrusive
+ * doubly linked list over a fixed vector: lookups, promotions and evictions are O(1) with no
+ * hashing and no allocation. Once a key has processed 'codebook_after' blocks in the sequential
+ * modes, where a table load replaces a chain of dependent rounds, get() also fetches its codebook
+ * from a CodebookCache, which builds it if needed and bounds the memory of all the codebooks;
+ * use() releases it, so an entry only holds its codebook during a request. Not thread-safe (used
+ * by the event loop), unlike the CodebookCache, which may be shared.
+ */
+class KeyCache {
+public:
+
+    struct Entry {
+        uint16_t key = 0;
+        uint16_t round_keys[3] = {};
+        uint64_t blocks = 0;            // Blocks processed sequentially with this key
+        shared_ptr<const Codebook> codebook;    // Held from get() to use() once the key is hot
+        int32_t prev = -1, next = -1;   // LRU list, most recent first
+
+        uint16_t encrypt(uint16_t block) const {
+            return codebook ? codebook->encrypt(block) : FastSAES::encrypt(block, round_keys);
+        }
+    };
+
+    uint64_t hits = 0, misses = 0;
+
+    /**
+     * @brief Constructs an empty cache.
+     *
+     * @param capacity Number of keys kept (at least 1).
+     * @param codebooks_ Where the codebooks of hot keys come from (nullptr: never used).
+     * @param codebook_after_ Sequential blocks after which a key uses its codebook (0: never).
+     */
+    KeyCache(size_t capacity, CodebookCache* codebooks_ = nullptr, uint64_t codebook_after_ = 1 << 16)
+        : entries(max<size_t>(capacity, 1)), slots(1 << 16, -1), codebooks(codebooks_), codebook_after(codebook_after_) {}
+
+    /**
+     * @brief Returns the entry of 'key', now the most recently used, expanding it on a miss and
+     * with its codebook if the key is hot.
+     */
+    Entry& get(uint16_t key) {
+        int32_t slot = slots[key];
+        if(slot >= 0){
+            hits++;
+            unlink(slot);
+        } else {
+            misses++;
+            if(used < entries.size()) slot = (int32_t)used++;
+            else {
+                slot = tail;
+                unlink(slot);
+                slots[entries[slot].key] = -1;
+            }
+            Entry& entry = entries[slot];
+            entry.key = key;
+            entry.blocks = 0;
+            FastSAES::expand_key(key, entry.round_keys);
+            slots[key] = slot;
+        }
+        push_front(slot);
+        Entry& entry = entries[slot];
+        if(codebooks && codebook_after && entry.blocks >= codebook_after) entry.codebook = codebooks->get(key);
+        return entry;
+    }
+
+    /**
+     * @brief Counts the sequential blocks a request processed with a key and releases its codebook.
+     */
+    void use(Entry& entry, uint64_t blocks) {
+        entry.blocks += blocks;
+        entry.codebook.reset();
+    }
+
+private:
+
+    vector<Entry> entries;
+    vector<int32_t> slots;      // slots[key]: index in entries, -1 if absent
+    CodebookCache* codebooks;
+    uint64_t codebook_after;
+    size_t used = 0;
+    int32_t head = -1, tail = -1;
+
+    void unlink(int32_t slot) {
+        Entry& entry = entries[slot];
+        if(entry.prev >= 0) entries[entry.prev].next = entry.next;
+        else head = entry.next;
+        if(entry.next >= 0) entries[entry.next].prev = entry.prev;
+        else tail = entry.prev;
+        entry.prev = entry.next = -1;
+    }
+
+    void push_front(int32_t slot) {
+        entries[slot].next = head;
+        if(head >= 0) entries[head].prev = slot;
+        head = slot;
+        if(tail < 0) tail = slot;
+    }
+};
+
+/**
+ * @class Daemon
+ * @brief Long-running encryption service on a Unix domain socket.
+ *
+ * @details A single-threaded epoll loop accepts connections and reads framed requests (see
+ * DaemonProtocol) from all of them without blocking. The requests read in one wakeup form a
+ * batch: every block that does not depend on the previous one (ECB, the CTR keystream, CBC and
+ * CFB decryption) is gathered, whatever its key, into one call of the multi-key bitsliced kernel
+ * (BitslicedSAES::encrypt_many / decrypt_many), so many small messages cost a single vectorized
+ * pass. Chained blocks (CBC and CFB encryption, OFB) are processed per request with the key's
+ * cached schedule, or its codebook once the key is hot (see KeyCache); the codebooks are kept in
+ * a CodebookCache under a memory budget.
+ *
+ * Responses are queued per connection and written as the socket accepts them; a client may
+ * pipeline requests, and the responses of one connection come back in request order. A
+ * connection whose unsent responses exceed MAX_BACKLOG is not read until it catches up.
+ * A malformed frame closes its connection; a request that cannot be processed (bad length,
+ * padding or nonce) gets an error response.
+ */
+class Daemon {
+public:
+
+    static const size_t CACHE_KEYS = 256;           // Default number of keys in the KeyCache
+    static const size_t CODEBOOK_BUDGET = 64 << 20; // Default memory of the cached codebooks
+    static const size_t MAX_BACKLOG = 1 << 22;      // Unsent response bytes before reads pause
+    static const size_t READ_CHUNK = 1 << 16;
+
+    /**
+     * @brief Counters of the daemon since its start.
+     */
+    struct Stats {
+        uint64_t connections = 0;
+        uint64_t requests = 0;
+        uint64_t batches = 0;           // Wakeups that processed at least one request
+        uint64_t batched_blocks = 0;    // Blocks that went through the multi-key kernel
+    };
+
+    /**
+     * @brief Creates the socket and starts listening.
+     *
+     * @details A socket file left behind by a daemon that is gone is replaced; the daemon refuses
+     * to start if another one still answers on 'path', or if 'path' is anything but a socket.
+     *
+     * @param path_ Path of the Unix domain socket.
+     * @param cache_keys Number of keys kept in the KeyCache.
+     * @param codebook_budget Memory the codebooks of hot keys may use (0: no codebooks).
+     * @throws runtime_error if the socket cannot be created or 'path' is in use.
+     */
+    Daemon(const string& path_, size_t cache_keys = CACHE_KEYS, size_t codebook_budget = CODEBOOK_BUDGET)
+        : path(path_), codebooks(codebook_budget), cache(cache_keys, codebook_budget ? &codebooks : nullptr) {
+        sockaddr_un address{};
+        if(path.size() >= sizeof(address.sun_path)) throw runtime_error("socket path too long: " + path);
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        epoll = epoll_create1(EPOLL_CLOEXEC);
+        wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(listener < 0 || epoll < 0 || wakeup < 0) fail("cannot create the daemon sockets");
+        remove_stale_socket(address);
+        if(bind(listener, (sockaddr*)&address, sizeof(address)) < 0) fail("cannot bind " + path);
+        struct stat st;
+        if(lstat(path.c_str(), &st) == 0) bound = {st.st_dev, st.st_ino};
+        if(listen(listener, SOMAXCONN) < 0) fail("cannot listen on " + path);
+        watch(listener, LISTENER, EPOLLIN, EPOLL_CTL_ADD);
+        watch(wakeup, WAKEUP, EPOLLIN, EPOLL_CTL_ADD);
+    }
+
+    ~Daemon() {
+        for(auto &[id, connection] : connections) ::close(connection.fd);
+        close_all();
+        // Only our own socket: the path may have been replaced since
+        struct stat st;
+        if(bound && lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)
+           && st.st_dev == bound->first && st.st_ino == bound->second) ::unlink(path.c_str());
+    }
+
+    Daemon(const Daemon&) = delete;
+    Daemon& operator=(const Daemon&) = delete;
+
+    /**
+     * @brief Serves requests until stop() is called.
+     */
+    void run() {
+        epoll_event events[64];
+        while(!stopping.load(memory_order_relaxed)){
+            int n = epoll_wait(epoll, events, 64, -1);
+            if(n < 0){
+                if(errno == EINTR) continue;
+                throw runtime_error(string("epoll_wait failed: ") + strerror(errno));
+            }
+            for(int i=0; i < n; i++){
+                uint64_t id = events[i].data.u64;
+                if(id == LISTENER) accept_all();
+                else if(id == WAKEUP) drain_wakeup();
+                else handle(id, events[i].events);
+            }
+            if(pending > 0) process_batch();
+            for(uint64_t id : touched) update(id);
+            touched.clear();
+        }
+    }
+
+    /**
+     * @brief Makes run() return; safe from another thread or a signal handler.
+     */
+    void stop() {
+        stopping.store(true, memory_order_relaxed);
+        uint64_t one = 1;
+        ssize_t ignored = ::write(wakeup, &one, sizeof(one));
+        (void)ignored;
+    }
+
+    const Stats& stats() const {
+        return counters;
+    }
+
+    const KeyCache& key_cache() const {
+        return cache;
+    }
+
+    const CodebookCache& codebook_cache() const {
+        return codebooks;
+    }
+
+private:
+
+    typedef DaemonProtocol P;
+
+    static const uint64_t LISTENER = 0, WAKEUP = 1;
+
+    struct Connection {
+        int fd = -1;
+        vector<uint8_t> in;         // Bytes read, not yet parsed
+        vector<uint8_t> out;        // Responses not yet sent, from 'sent' on
+        size_t sent = 0;
+        bool eof = false;           // The peer shut down its side
+        uint32_t events = 0;        // Events currently watched
+    };
+
+    struct Request {
+        uint64_t connection = 0;
+        uint32_t id = 0;
+        uint8_t op = 0, flags = 0;
+        P::Mode mode = P::Mode::ECB;
+        uint16_t key = 0, iv = 0;
+        vector<uint8_t> data;       // Payload, transformed in place into the output
+        string error;
+        size_t first = 0;           // First block of the request in the batch arrays
+    };
+
+    string path;
+    optional<pair<dev_t, ino_t>> bound;     // The socket file this daemon created
+    int listener = -1, epoll = -1, wakeup = -1;
+    atomic<bool> stopping{false};
+    uint64_t next_id = 2;
+    unordered_map<uint64_t, Connection> connections;
+    vector<uint64_t> touched;       // Connections to flush and re-arm after this wakeup
+    CodebookCache codebooks;
+    KeyCache cache;
+    Stats counters;
+
+    // Requests of the current batch; the elements are reused, with their buffers, across batches
+    vector<Request> requests;
+    size_t pending = 0;
+    vector<uint16_t> enc_keys, enc_blocks, enc_out, dec_keys, dec_blocks, dec_out;
+
+    [[noreturn]] void fail(const string& message) {
+        string text = message + ": " + strerror(errno);
+        close_all();
+        throw runtime_error(text);
+    }
+
+    // Removes the socket file of a daemon that is gone; refuses to touch a live socket or any other file
+    void remove_stale_socket(const sockaddr_un& address) {
+        struct stat st;
+        if(lstat(path.c_str(), &st) < 0){
+            if(errno == ENOENT) return;
+            fail("cannot stat " + path);
+        }
+        if(!S_ISSOCK(st.st_mode)){
+            close_all();
+            throw runtime_error("cannot bind " + path + ": path exists and is not a socket");
+        }
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(probe < 0) fail("cannot create the daemon sockets");
+        bool live = connect(probe, (const sockaddr*)&address, sizeof(address)) == 0;
+        int error = errno;
+        ::close(probe);
+        if(live){
+            close_all();
+            throw runtime_error("a daemon is already listening on " + path);
+        }
+        errno = error;
+        if(error != ECONNREFUSED) fail("cannot probe " + path);
+        if(::unlink(path.c_str()) < 0) fail("cannot remove the stale socket " + path);
+    }
+
+    void close_all() {
+        for(int fd : {listener, epoll, wakeup}) if(fd >= 0) ::close(fd);
+        listener = epoll = wakeup = -1;
+    }
+
+    void watch(int fd, uint64_t id, uint32_t events, int operation) {
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = id;
+        if(epoll_ctl(epoll, operation, fd, &event) < 0 && operation != EPOLL_CTL_DEL)
+            throw runtime_error(string("epoll_ctl failed: ") + strerror(errno));
+    }
+
+    void accept_all() {
+        while(true){
+            int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if(fd < 0){
+                if(errno == EINTR) continue;
+                return; // EAGAIN, or a connection that failed before being accepted
+            }
+            uint64_t id = next_id++;
+            Connection& connection = connections[id];
+            connection.fd = fd;
+            connection.events = EPOLLIN;
+            watch(fd, id, EPOLLIN, EPOLL_CTL_ADD);
+            counters.connections++;
+        }
+    }
+
+    void drain_wakeup() {
+        uint64_t value;
+        ssize_t ignored = ::read(wakeup, &value, sizeof(value));
+        (void)ignored;
+    }
+
+    void handle(uint64_t id, uint32_t events) {
+        auto it = connections.find(id);
+        if(it == connections.end()) return;
+        Connection& connection = it->second;
+        if(events & EPOLLIN){
+            if(!read_requests(id, connection)){
+                close_connection(id);
+                return;
+            }
+        }
+        if(events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) touched.push_back(id);
+    }
+
+    // Reads what is available and queues the complete requests; false on an error or a bad frame
+    bool read_requests(uint64_t id, Connection& connection) {
+        while(true){
+            size_t old = connection.in.size();
+            connection.in.resize(old + READ_CHUNK);
+            ssize_t r = ::read(connection.fd, connection.in.data() + old, READ_CHUNK);
+            connection.in.resize(old + (r > 0 ? (size_t)r : 0));
+            if(r > 0) continue;
+            if(r == 0){
+                connection.eof = true;
+                break;
+            }
+            if(errno == EINTR) continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+
+        size_t offset = 0;
+        const uint8_t* in = connection.in.data();
+        while(connection.in.size() - offset >= 4){
+            uint32_t length = P::get32(in + offset);
+            if(length < P::REQUEST_HEADER || length > P::REQUEST_HEADER + P::MAX_PAYLOAD) return false;
+            if(connection.in.size() - offset - 4 < length) break;
+            queue_request(id, in + offset + 4, length);
+            offset += 4 + length;
+        }
+        connection.in.erase(connection.in.begin(), connection.in.begin() + offset);
+        touched.push_back(id);
+        return true;
+    }
+
+    void queue_request(uint64_t connection, const uint8_t* body, size_t length) {
+        if(pending == requests.size()) requests.emplace_back();
+        Request& request = requests[pending++];
+        request.connection = connection;
+        request.id = P::get32(body);
+        request.op = body[4];
+        request.mode = (P::Mode)body[5];
+        request.flags = body[6];
+        request.key = P::get16(body + 8);
+        request.iv = P::get16(body + 10);
+        request.data.assign(body + P::REQUEST_HEADER, body + length);
+        request.error.clear();
+        counters.requests++;
+    }
+
+    void close_connection(uint64_t id) {
+        auto it = connections.find(id);
+        if(it == connections.end()) return;
+        watch(it->second.fd, id, 0, EPOLL_CTL_DEL);
+        ::close(it->second.fd);
+        connections.erase(it);
+    }
+
+    // Sends queued responses, then watches the events the connection now needs (or closes it)
+    void update(uint64_t id) {
+        auto it = connections.find(id);
+        if(it == connections.end()) return;
+        Connection& connection = it->second;
+        while(connection.sent < connection.out.size()){
+            ssize_t w = send(connection.fd, connection.out.data() + connection.sent,
+                             connection.out.size() - connection.sent, MSG_NOSIGNAL);
+            if(w > 0) connection.sent += (size_t)w;
+            else if(w < 0 && errno == EINTR) continue;
+            else if(w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            else {
+                close_connection(id);
+                return;
+            }
+        }
+        size_t backlog = connection.out.size() - connection.sent;
+        if(backlog == 0){
+            connection.out.clear();
+            connection.sent = 0;
+            if(connection.eof){
+                close_connection(id);
+                return;
+            }
+        }
+        uint32_t events = (connection.eof || backlog >= MAX_BACKLOG ? 0u : (uint32_t)EPOLLIN) | (backlog > 0 ? (uint32_t)EPOLLOUT : 0u);
+        if(events != connection.events){
+            watch(connection.fd, id, events, EPOLL_CTL_MOD);
+            connection.events = events;
+        }
+    }
+
+    /*  Processes the queued requests in three passes:
+        1. validation, padding and gathering of the independent blocks into the batch arrays,
+        2. one multi-key kernel call per direction over all the gathered blocks,
+        3. per request: scattering of the results, chained modes, unpadding and the response.
+    */
+    void process_batch() {
+        Instrument::Timer timer(Instrument::CIPHER);
+        enc_keys.clear(); enc_blocks.clear(); dec_keys.clear(); dec_blocks.clear();
+        for(size_t r=0; r < pending; r++){
+            try {
+                gather(requests[r]);
+            } catch(const exception& e) {
+                requests[r].error = e.what();
+            }
+        }
+
+        enc_out.resize(enc_blocks.size());
+        dec_out.resize(dec_blocks.size());
+        BitslicedSAES::encrypt_many(enc_keys.data(), enc_blocks.data(), enc_out.data(), enc_blocks.size());
+        BitslicedSAES::decrypt_many(dec_keys.data(), dec_blocks.data(), dec_out.data(), dec_blocks.size());
+        counters.batched_blocks += enc_blocks.size() + dec_blocks.size();
+        counters.batches++;
+
+        for(size_t r=0; r < pending; r++){
+            Request& request = requests[r];
+            if(request.error.empty()){
+                try {
+                    finish(request);
+                } catch(const exception& e) {
+                    request.error = e.what();
+                }
+            }
+            respond(request);
+        }
+        pending = 0;
+    }
+
+    static uint16_t block_at(const vector<uint8_t>& data, size_t i) {
+        return P::get16(data.data() + 2 * i);
+    }
+
+    void add(vector<uint16_t>& keys, vector<uint16_t>& blocks, uint16_t key, uint16_t block) {
+        keys.push_back(key);
+        blocks.push_back(block);
+    }
+
+    void gather(Request& request) {
+        if(request.op > P::DECRYPT || request.mode > P::Mode::CTR) throw invalid_argument("unknown operation or mode");
+        vector<uint8_t>& data = request.data;
+        bool decrypt = request.op == P::DECRYPT;
+        bool block_mode = request.mode == P::Mode::ECB || request.mode == P::Mode::CBC;
+        if(block_mode && !decrypt && (request.flags & P::PAD)){
+            size_t size = data.size();
+            data.resize(size + PKCS7::pad_length(size));
+            PKCS7::pad(data.data(), size);
+        }
+        if(block_mode && data.size() % 2 != 0) throw invalid_argument("length must be a multiple of 2 bytes");
+        int counter_bits = 0;
+        if(request.mode == P::Mode::CTR){
+            int nonce_bits = CTR::nonce_bits_for(data.size());
+            if(request.iv >= (1 << nonce_bits))
+                throw invalid_argument("the CTR nonce must fit in " + to_string(nonce_bits) + " bits");
+            counter_bits = 16 - nonce_bits;
+        }
+
+        size_t blocks = (data.size() + 1) / 2;
+        switch(request.mode){
+            case P::Mode::ECB:
+                request.first = decrypt ? dec_blocks.size() : enc_blocks.size();
+                for(size_t i=0; i < blocks; i++){
+                    if(decrypt) add(dec_keys, dec_blocks, request.key, block_at(data, i));
+                    else add(enc_keys, enc_blocks, request.key, block_at(data, i));
+                }
+                break;
+            case P::Mode::CTR:
+                request.first = enc_blocks.size();
+                for(size_t i=0; i < blocks; i++) add(enc_keys, enc_blocks, request.key, (uint16_t)((request.iv << counter_bits) | i));
+                break;
+            case P::Mode::CBC:
+                if(!decrypt) break;
+                request.first = dec_blocks.size();
+                for(size_t i=0; i < blocks; i++) add(dec_keys, dec_blocks, request.key, block_at(data, i));
+                break;
+            case P::Mode::CFB:
+                if(!decrypt) break;
+                request.first = enc_blocks.size();
+                // Keystream block i encrypts the previous ciphertext block (the IV for the first)
+                for(size_t i=0; i < blocks; i++) add(enc_keys, enc_blocks, request.key, i == 0 ? request.iv : block_at(data, i - 1));
+                break;
+            case P::Mode::OFB:
+                break;
+        }
+    }
+
+    // XORs data with the batch output starting at 'first', read as big-endian keystream blocks
+    static void xor_keystream(vector<uint8_t>& data, const uint16_t* keystream) {
+        for(size_t i=0; i < data.size(); i++) data[i] ^= (uint8_t)(i % 2 ? keystream[i / 2] & 0xFF : keystream[i / 2] >> 8);
+    }
+
+    void finish(Request& request) {
+        vector<uint8_t>& data = request.data;
+        bool decrypt = request.op == P::DECRYPT;
+        size_t blocks = (data.size() + 1) / 2;
+        switch(request.mode){
+            case P::Mode::ECB: {
+                const uint16_t* out = (decrypt ? dec_out.data() : enc_out.data()) + request.first;
+                for(size_t i=0; i < blocks; i++) P::put16(data.data() + 2 * i, out[i]);
+                break;
+            }
+            case P::Mode::CTR:
+                xor_keystream(data, enc_out.data() + request.first);
+                break;
+            case P::Mode::CFB:
+                if(decrypt) xor_keystream(data, enc_out.data() + request.first);
+                else chain_cfb(request);
+                break;
+            case P::Mode::CBC:
+                if(decrypt){
+                    uint16_t previous = request.iv;
+                    for(size_t i=0; i < blocks; i++){
+                        uint16_t cipher = block_at(data, i);
+                        P::put16(data.data() + 2 * i, dec_out[request.first + i] ^ previous);
+                        previous = cipher;
+                    }
+                }
+                else chain_cbc(request);
+                break;
+            case P::Mode::OFB:
+                chain_ofb(request);
+                break;
+        }
+        if((request.mode == P::Mode::ECB || request.mode == P::Mode::CBC) && decrypt && (request.flags & P::PAD))
+            data.resize(PKCS7::unpad(data.data(), data.size()));
+    }
+
+    void chain_cbc(Request& request) {
+        KeyCache::Entry& entry = cache.get(request.key);
+        vector<uint8_t>& data = request.data;
+        uint16_t previous = request.iv;
+        for(size_t i=0; i < data.size(); i += 2){
+            previous = entry.encrypt((uint16_t)(P::get16(data.data() + i) ^ previous));
+            P::put16(data.data() + i, previous);
+        }
+        cache.use(entry, data.size() / 2);
+    }
+
+    void chain_cfb(Request& request) {
+        KeyCache::Entry& entry = cache.get(request.key);
+        vector<uint8_t>& data = request.data;
+        size_t whole = data.size() & ~(size_t)1;
+        uint16_t previous = request.iv;
+        for(size_t i=0; i < whole; i += 2){
+            previous = entry.encrypt(previous) ^ P::get16(data.data() + i);
+            P::put16(data.data() + i, previous);
+        }
+        if(whole < data.size()) data[whole] ^= entry.encrypt(previous) >> 8;
+        cache.use(entry, (data.size() + 1) / 2);
+    }
+
+    void chain_ofb(Request& request) {
+        KeyCache::Entry& entry = cache.get(request.key);
+        vector<uint8_t>& data = request.data;
+        uint16_t state = request.iv;
+        for(size_t i=0; i < data.size(); i += 2){
+            state = entry.encrypt(state);
+            data[i] ^= state >> 8;
+            if(i + 1 < data.size()) data[i + 1] ^= state & 0xFF;
+        }
+        cache.use(entry, (data.size() + 1) / 2);
+    }
+
+    void respond(const Request& request) {
+        auto it = connections.find(request.connection);
+        if(it == connections.end()) return; // Closed meanwhile
+        vector<uint8_t>& out = it->second.out;
+        bool ok = request.error.empty();
+        size_t size = ok ? request.data.size() : request.error.size();
+        size_t start = out.size();
+        out.resize(start + 4 + P::RESPONSE_HEADER + size);
+        uint8_t* frame = out.data() + start;
+        P::put32(frame, (uint32_t)(P::RESPONSE_HEADER + size));
+        P::put32(frame + 4, request.id);
+        frame[8] = ok ? P::OK : P::ERROR;
+        if(size > 0) memcpy(frame + 4 + P::RESPONSE_HEADER, ok ? request.data.data() : (const uint8_t*)request.error.data(), size);
+    }
+};
+
+/**
+ * @class DaemonClient
+ * @brief Blocking client of a Daemon, with optional pipelining.
+ *
+ * @details call() sends one request and waits for its response. For throughput, send() several
+ * requests first and receive() their responses afterwards (in the same order): the daemon
+ * batches the requests that arrive together.
+ */
+class DaemonClient {
+public:
+
+    /**
+     * @brief A response of the daemon.
+     */
+    struct Response {
+        uint32_t id = 0;
+        bool ok = false;
+        vector<uint8_t> data;   // The output bytes, or the error message
+    };
+
+    /**
+     * @brief Connects to the daemon listening on 'path'.
+     *
+     * @throws runtime_error if the connection fails.
+     */
+    DaemonClient(const string& path) {
+        sockaddr_un address{};
+        if(path.size() >= sizeof(address.sun_path)) throw runtime_error("socket path too long: " + path);
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(fd < 0 || connect(fd, (sockaddr*)&address, sizeof(address)) < 0){
+            string message = "cannot connect to " + path + ": " + strerror(errno);
+            if(fd >= 0) ::close(fd);
+            throw runtime_error(message);
+        }
+    }
+
+    ~DaemonClient() {
+        ::close(fd);
+    }
+
+    DaemonClient(const DaemonClient&) = delete;
+    DaemonClient& operator=(const DaemonClient&) = delete;
+
+    /**
+     * @brief Sends a request without waiting for the response.
+     *
+     * @return The id of the request, echoed by its response.
+     */
+    uint32_t send(DaemonProtocol::Op op, DaemonProtocol::Mode mode, uint16_t key, uint16_t iv,
+                  span<const uint8_t> payload, uint8_t flags = 0) {
+        if(payload.size() > DaemonProtocol::MAX_PAYLOAD) throw invalid_argument("payload too large");
+        uint8_t header[4 + DaemonProtocol::REQUEST_HEADER] = {};
+        uint32_t id = next_id++;
+        DaemonProtocol::put32(header, (uint32_t)(DaemonProtocol::REQUEST_HEADER + payload.size()));
+        DaemonProtocol::put32(header + 4, id);
+        header[8] = op;
+        header[9] = (uint8_t)mode;
+        header[10] = flags;
+        DaemonProtocol::put16(header + 12, key);
+        DaemonProtocol::put16(header + 14, iv);
+        write_full(fd, header, sizeof(header));
+        write_full(fd, payload.data(), payload.size());
+        return id;
+    }
+
+    /**
+     * @brief Waits for the next response.
+     *
+     * @throws runtime_error if the connection is closed or the frame is malformed.
+     */
+    Response receive() {
+        uint8_t length[4];
+        if(read_full(fd, length, 4) != 4) throw runtime_error("connection closed by the daemon");
+        uint32_t size = DaemonProtocol::get32(length);
+        if(size < DaemonProtocol::RESPONSE_HEADER) throw runtime_error("malformed response");
+        vector<uint8_t> body(size);
+        if(read_full(fd, body.data(), size) != size) throw runtime_error("connection closed by the daemon");
+        Response response;
+        response.id = DaemonProtocol::get32(body.data());
+        response.ok = body[4] == DaemonProtocol::OK;
+        response.data.assign(body.begin() + DaemonProtocol::RESPONSE_HEADER, body.end());
+        return response;
+    }
+
+    /**
+     * @brief Sends a request and returns its output.
+     *
+     * @throws runtime_error with the daemon's message if the request fails.
+     */
+    vector<uint8_t> call(DaemonProtocol::Op op, DaemonProtocol::Mode mode, uint16_t key, uint16_t iv,
+                         span<const uint8_t> payload, uint8_t flags = 0) {
+        send(op, mode, key, iv, payload, flags);
+        Response response = receive();
+        if(!response.ok) throw runtime_error("daemon: " + string(response.data.begin(), response.data.end()));
+        return response.data;
+    }
+
+private:
+
+    int fd = -1;
+    uint32_t next_id = 1;
+};
+
+#endif
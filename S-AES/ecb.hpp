@@ -1,87 +1,269 @@
 
 #include <iostream>
 #include <string>
-#include <cassert>
+#include <string_view>
+#include <cstring>
 #include <vector>
+#include <span>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
 
 #include "s-aes.hpp"
+#include "bitslice.hpp"
+#include "thread-pool.hpp"
+#include "padding.hpp"
 #include "util.hpp"
 #include "base64.hpp"
+#include "buffer-pool.hpp"
 
 using namespace std;
 
+#ifndef ECB_HPP
+#define ECB_HPP
+
 /**
  * @class ECB
  * @brief ECB (Electronic Codebook) mode encryption class for S-AES.
  * 
  * @details This class provides methods to encrypt and decrypt data using the S-AES
- * cipher in ECB mode. The encryption and decryption processes operate on 16-bit blocks,
- * and the class uses Base64 encoding for output and input of ciphertext.
+ * cipher in ECB mode. The encryption and decryption processes operate on 16-bit blocks.
+ * The core API works on byte spans (in-place allowed); the string API adds Base64 encoding
+ * of the ciphertext as an outer layer and, when 'padding' is set, PKCS#7 padding.
+ * Its overloads writing into a caller-held string allocate nothing in steady state (see BufferPool).
+ * Messages of at least one kernel batch (64 to 512 blocks, depending on the CPU) are processed
+ * by the bitsliced SIMD engine; shorter ones block by block with the fast S-AES path.
+ * With more than one thread configured, large inputs are split into cache-sized chunks
+ * encrypted concurrently into disjoint regions of the output.
  */
 class ECB {
 public:
+
+    static const size_t ALIGNMENT = 2;          // Inputs are whole 16-bit blocks
+    static const size_t CHUNK_BLOCKS = 1 << 14; // 32 KiB per parallel task
+
     int key;
+    bool padding;
     SAES saes;
+    BitslicedSAES bitsliced;
 
     /**
      * @brief Constructs an ECB mode encryption object with the given key.
      * 
      * @param key_ The 16-bit integer key used to initialize the S-AES cipher.
+     * @param padding_ Applies PKCS#7 padding in the string and streaming APIs (default: false,
+     * messages must then be a whole number of blocks).
+     */
+    ECB(int key_, bool padding_ = false) : key(key_), padding(padding_), saes(key_), bitsliced(key_) {}
+
+    /**
+     * @brief Sets the number of threads used for large inputs.
+     * 
+     * @param threads Total number of threads (1: serial, 0: one per hardware thread).
+     */
+    void set_threads(int threads) {
+        pool = threads == 1 ? nullptr : make_shared<ThreadPool>(threads);
+    }
+
+    /**
+     * @brief Uses an existing thread pool (possibly shared with other modes) for large inputs.
+     * 
+     * @param pool_ The pool, or nullptr for serial processing.
+     */
+    void set_pool(shared_ptr<ThreadPool> pool_) {
+        pool = pool_;
+    }
+
+    /**
+     * @brief Traces a sample of the blocks (see TraceSink).
+     * 
+     * @details The bulk engines are left untouched: before a buffer is processed, each block is
+     * offered to the sink and the sampled ones are run once more through the reference path,
+     * which records their steps. Without a sink, nothing is done per block.
+     * 
+     * @param trace The sink (not owned), or nullptr to stop tracing.
      */
-    ECB(int key_) : key(key_), saes(key_, false, true) {}
+    void set_trace(TraceSink* trace) {
+        saes.trace = trace;
+    }
+
+    /**
+     * @brief Replaces the key used by this ECB object.
+     * 
+     * @details The round-key schedules of both engines are recomputed, nothing is reallocated.
+     * 
+     * @param key_ The new 16-bit key.
+     */
+    void rekey(int key_) {
+        key = key_;
+        saes.rekey(key_);
+        bitsliced.rekey(key_);
+    }
+
+    /**
+     * @brief Encrypts a byte buffer using S-AES in ECB mode.
+     * 
+     * @details The input is read as big-endian 16-bit blocks, each one encrypted independently
+     * and written at the same offset of the output. No intermediate copy is made and the
+     * output may be the input itself (in-place encryption).
+     * 
+     * @param in The plaintext bytes (even length).
+     * @param out The destination, at least in.size() bytes.
+     * @throws invalid_argument if the length is odd or the output is too small.
+     */
+    void encrypt(span<const uint8_t> in, span<uint8_t> out) {
+        Instrument::count_bytes(in.size());
+        Instrument::Timer timer(Instrument::CIPHER);
+        process(in, out, false);
+    }
+
+    /**
+     * @brief Decrypts a byte buffer using S-AES in ECB mode.
+     * 
+     * @details Inverse of encrypt(span, span); in-place decryption is allowed.
+     * 
+     * @param in The ciphertext bytes (even length).
+     * @param out The destination, at least in.size() bytes.
+     * @throws invalid_argument if the length is odd or the output is too small.
+     */
+    void decrypt(span<const uint8_t> in, span<uint8_t> out) {
+        Instrument::count_bytes(in.size());
+        Instrument::Timer timer(Instrument::CIPHER);
+        process(in, out, true);
+    }
 
     /**
      * @brief Encrypts a plaintext string using S-AES in ECB mode.
      * 
-     * @details The plaintext is first converted into bytes, 
-     * then split into 16-bit (2-byte) blocks.
-     * Each block is encrypted using S-AES, and the resulting 
-     * ciphertext is concatenated and encoded in Base64.
+     * @details The plaintext bytes are copied once into a pooled buffer, padded if enabled,
+     * encrypted in place as 16-bit (2-byte) blocks, and the resulting 
+     * ciphertext is encoded in Base64.
      * 
      * @param plaintext The input string to be encrypted.
      * @return A Base64-encoded string representing the ciphertext.
+     * @throws invalid_argument if padding is disabled and the length is odd.
      */
-    string encrypt(string plainText) {
-        auto bytes = get_bytes_from_text(plainText);
-        assert((int)bytes.size() % 2 == 0);
-        
-        vector<int> result;
-
-        for(int i = 0; i < (int)bytes.size(); i += 2) {
-            auto slice = get_vector_slice(bytes, i, 2);
-            int num = (slice[0] << 8) + slice[1];
-            int res = saes.encrypt(num);
-            result.push_back(res >> 8);
-            result.push_back(res & 0xFF);
-        }
+    string encrypt(const string& plainText) {
+        string cipherText;
+        encrypt(plainText, cipherText);
+        return cipherText;
+    }
 
-        return Base64::convert_to(result);
+    /**
+     * @brief Encrypts a plaintext string into a Base64 ciphertext held by the caller.
+     * 
+     * @details Same result as encrypt(const string&), without allocating once the buffers are
+     * large enough: the padded blocks are encrypted in a buffer leased from the thread's
+     * BufferPool and the ciphertext reuses the capacity of 'cipherText'. A loop encrypting
+     * many messages into the same string runs without heap allocations in steady state.
+     * 
+     * @param plainText The input bytes to be encrypted.
+     * @param cipherText Receives the Base64-encoded ciphertext.
+     * @throws invalid_argument if padding is disabled and the length is odd.
+     */
+    void encrypt(string_view plainText, string& cipherText) {
+        if(!padding && plainText.size() % 2 != 0) throw invalid_argument("plaintext length must be a multiple of 2 bytes");
+        BufferPool::Buffer bytes(plainText.size() + (padding ? PKCS7::pad_length(plainText.size()) : 0));
+        memcpy(bytes.data(), plainText.data(), plainText.size());
+        if(padding) PKCS7::pad(bytes.data(), plainText.size());
+        encrypt(bytes, bytes);
+        Base64::convert_to(bytes, cipherText);
     }
 
 
    /**
      * @brief Decrypts a Base64-encoded ciphertext using the S-AES in ECB mode.
      * 
-     * @details The input ciphertext is first decoded from Base64 to obtain the raw encrypted bytes.
-     * These bytes are grouped into 16-bit (2-byte) blocks, and each block is decrypted using S-AES.
-     * The resulting plaintext bytes are concatenated and returned as a standard string.
+     * @details The input ciphertext is first decoded from Base64 straight into the returned string.
+     * These bytes are grouped into 16-bit (2-byte) blocks and decrypted in place inside the
+     * returned string, and the padding is removed if enabled.
      * 
      * @param cipherText The Base64-encoded ciphertext string to be decrypted.
      * @return The decrypted plaintext as a string.
+     * @throws invalid_argument if the ciphertext is not whole blocks or the padding is invalid.
      */
-    string decrypt(string cipherText) {
-        vector<int> encrypted_blocks = Base64::convert_from(cipherText);
-        vector<int> bytes;
-
-        for(int i = 0; i < (int)encrypted_blocks.size(); i += 2) {
-            int h = encrypted_blocks[i], l = encrypted_blocks[i + 1];
-            int res = (h << 8) + l;
-            int dec = saes.decrypt(res);
-            bytes.push_back(dec >> 8);
-            bytes.push_back(dec & 0xFF);
+    string decrypt(const string& cipherText) {
+        string plainText;
+        decrypt(cipherText, plainText);
+        return plainText;
+    }
+
+    /**
+     * @brief Decrypts a Base64-encoded ciphertext into a plaintext string held by the caller.
+     * 
+     * @details Same result as decrypt(const string&); the ciphertext is decoded and decrypted in
+     * place inside 'plainText', reusing its capacity (no allocation once it is large enough).
+     * 
+     * @param cipherText The Base64-encoded ciphertext.
+     * @param plainText Receives the plaintext.
+     * @throws invalid_argument if the ciphertext is not whole blocks or the padding is invalid.
+     */
+    void decrypt(string_view cipherText, string& plainText) {
+        if(Base64::decoded_length(cipherText.data(), cipherText.size()) % 2 != 0)
+            throw invalid_argument("ciphertext length must be a multiple of 2 bytes");
+        Base64::decode(cipherText, plainText);
+        span<uint8_t> bytes((uint8_t*)plainText.data(), plainText.size());
+        decrypt(bytes, bytes);
+        if(padding) plainText.resize(PKCS7::unpad(bytes.data(), bytes.size()));
+    }
+
+private:
+
+    shared_ptr<ThreadPool> pool; // nullptr: serial processing
+
+    // Messages filling at least one batch of the bitsliced kernel go through it
+    bool use_bitsliced(size_t blocks) const {
+        return blocks >= BitslicedSAES::batch_blocks(bitsliced.isa);
+    }
+
+    static void check_blocks(span<const uint8_t> in, span<uint8_t> out) {
+        if(in.size() % 2 != 0) throw invalid_argument("length must be a multiple of 2 bytes");
+        if(out.size() < in.size()) throw invalid_argument("output buffer too small");
+    }
+
+    // Splits large inputs into chunks processed by the thread pool, each into its own output region
+    void process(span<const uint8_t> in, span<uint8_t> out, bool decrypt) {
+        check_blocks(in, out);
+        size_t blocks = in.size() / 2;
+        if(saes.trace) trace_blocks(in, decrypt);
+
+        if(!pool || blocks < 2 * CHUNK_BLOCKS) {
+            process_range(in, out, decrypt);
+            return;
+        }
+        pool->parallel_for(blocks, CHUNK_BLOCKS, [&](size_t begin, size_t end) {
+            process_range(in.subspan(2 * begin, 2 * (end - begin)), out.subspan(2 * begin), decrypt);
+        });
+    }
+
+    // Offers every block to the trace sink and runs the sampled ones through the reference path
+    void trace_blocks(span<const uint8_t> in, bool decrypt) {
+        for(size_t i = 0; i < in.size(); i += 2) {
+            if(!saes.trace->sample()) continue;
+            int block = (in[i] << 8) | in[i + 1];
+            if(decrypt) saes.decrypt_reference(block);
+            else saes.encrypt_reference(block);
+        }
+    }
+
+    // Runs every block of 'in' through the selected engine into 'out'
+    void process_range(span<const uint8_t> in, span<uint8_t> out, bool decrypt) const {
+        size_t blocks = in.size() / 2;
+
+        if(use_bitsliced(blocks)) {
+            if(decrypt) bitsliced.decrypt(in.data(), out.data(), blocks);
+            else bitsliced.encrypt(in.data(), out.data(), blocks);
+            return;
         }
 
-        return string(bytes.begin(), bytes.end());
+        for(size_t i = 0; i < in.size(); i += 2) {
+            uint16_t block = (uint16_t)((in[i] << 8) | in[i + 1]);
+            block = decrypt ? FastSAES::decrypt(block, saes.round_keys) : FastSAES::encrypt(block, saes.round_keys);
+            out[i] = block >> 8;
+            out[i + 1] = block & 0xFF;
+        }
     }
 
-};
\ No newline at end of file
+};
+
+#endif
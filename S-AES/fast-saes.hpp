@@ -0,0 +1,167 @@
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <type_traits>
+#include "gf16.hpp"
+#include "instrument.hpp"
+
+using namespace std;
+
+#ifndef FAST_SAES_HPP
+#define FAST_SAES_HPP
+
+/**
+ * @class FastSAES
+ * @brief Allocation-free S-AES round functions operating on a packed 16-bit state.
+ *
+ * @details The whole S-AES state is kept in a single uint16_t, using the same layout as the
+ * nibble matrix of the SAES class:
+ *
+ *      bits 15-12 → s[0][0]    bits 7-4 → s[0][1]
+ *      bits 11-8  → s[1][0]    bits 3-0 → s[1][1]
+ *
+ * so each byte of the state is one column. This makes every step a handful of register operations:
+ * - SubNibbles: one 256-entry lookup per column (both nibbles of a byte at once)
+ * - ShiftRows: a bit permutation swapping the two low nibbles of each column
+ * - MixColumns: one 256-entry lookup per column, precomputed from the GF(2⁴) matrix product
+ * - AddRoundKey: a single XOR with the packed round key
+ *
+ * All tables are generated at compile time from gf16.hpp and every function is constexpr, so blocks
+ * under constant keys can be folded by the compiler; no heap allocation happens per block.
+ */
+class FastSAES {
+public:
+
+    // Row 0: encryption S-box | Row 1: decryption S-box
+    static constexpr const array<array<uint8_t, 16>, 2>& SBOX = SAES_SBOX;
+
+    // MixColumns matrices in GF(2⁴) | Row 0: encryption | Row 1: decryption
+    static constexpr const uint8_t (&MIX)[2][2][2] = SAES_MIX;
+
+    // Round constants of the key expansion for rounds 1 and 2: x^(round+2) mod x⁴ + x + 1, in the high nibble
+    static constexpr uint8_t RCON[2] = {
+        (uint8_t)(GF_16::mod(1 << 3) << 4),
+        (uint8_t)(GF_16::mod(1 << 4) << 4)
+    };
+
+    /**
+     * @brief Applies SubNibbles to the four nibbles of the state.
+     *
+     * @param state The packed 16-bit state.
+     * @param decrypt Uses the inverse S-box when true.
+     * @return The substituted state.
+     */
+    static constexpr uint16_t sub_nibbles(uint16_t state, bool decrypt = false) {
+        return (uint16_t)((SUB_BYTE[decrypt][state >> 8] << 8) | SUB_BYTE[decrypt][state & 0xFF]);
+    }
+
+    /**
+     * @brief Applies ShiftRows (swaps the second-row nibbles). The operation is its own inverse.
+     *
+     * @param state The packed 16-bit state.
+     * @return The shifted state.
+     */
+    static constexpr uint16_t shift_rows(uint16_t state) {
+        return (uint16_t)((state & 0xF0F0) | ((state >> 8) & 0x000F) | ((state << 8) & 0x0F00));
+    }
+
+    /**
+     * @brief Applies MixColumns to both columns of the state.
+     *
+     * @param state The packed 16-bit state.
+     * @param decrypt Uses the inverse matrix when true.
+     * @return The mixed state.
+     */
+    static constexpr uint16_t mix_columns(uint16_t state, bool decrypt = false) {
+        return (uint16_t)((MIX_BYTE[decrypt][state >> 8] << 8) | MIX_BYTE[decrypt][state & 0xFF]);
+    }
+
+    /**
+     * @brief Expands a 16-bit key into the three packed round keys.
+     *
+     * @details w2 = w0 ⊕ RCON1 ⊕ SubNib(RotNib(w1)), w3 = w2 ⊕ w1, and likewise for w4, w5.
+     *
+     * @param key The 16-bit cipher key.
+     * @param round_keys Output: Key0, Key1 and Key2 as packed 16-bit words.
+     */
+    static constexpr void expand_key(uint16_t key, uint16_t round_keys[3]) {
+        if(!is_constant_evaluated()) Instrument::count(Instrument::KEY_EXPANSIONS);
+        uint8_t w0 = key >> 8, w1 = key & 0xFF;
+        round_keys[0] = key;
+        for(int round=1; round <= 2; round++){
+            uint8_t rot = (uint8_t)((w1 << 4) | (w1 >> 4));
+            w0 ^= RCON[round-1] ^ SUB_BYTE[0][rot];
+            w1 ^= w0;
+            round_keys[round] = (uint16_t)((w0 << 8) | w1);
+        }
+    }
+
+    /**
+     * @brief Expands the round-key schedules of many keys at once.
+     *
+     * @details Branch-free loop over expand_key, meant for key-search and key-rotation jobs
+     * that need the schedules of thousands of keys.
+     *
+     * @param keys Array of 'count' 16-bit keys.
+     * @param count Number of keys.
+     * @param round_keys Output: round_keys[i] receives Key0, Key1 and Key2 of keys[i].
+     */
+    static void expand_keys(const uint16_t* keys, size_t count, uint16_t (*round_keys)[3]) {
+        for(size_t i=0; i < count; i++) expand_key(keys[i], round_keys[i]);
+    }
+
+    /**
+     * @brief Encrypts a 16-bit block with an already expanded key.
+     *
+     * @param block The 16-bit plaintext block.
+     * @param round_keys The three packed round keys (see expand_key).
+     * @return The 16-bit ciphertext block.
+     */
+    static constexpr uint16_t encrypt(uint16_t block, const uint16_t round_keys[3]) {
+        uint16_t state = (uint16_t)(block ^ round_keys[0]);
+        state = (uint16_t)(mix_columns(shift_rows(sub_nibbles(state))) ^ round_keys[1]);
+        return (uint16_t)(shift_rows(sub_nibbles(state)) ^ round_keys[2]);
+    }
+
+    /**
+     * @brief Decrypts a 16-bit block with an already expanded key.
+     *
+     * @param block The 16-bit ciphertext block.
+     * @param round_keys The three packed round keys (see expand_key).
+     * @return The 16-bit plaintext block.
+     */
+    static constexpr uint16_t decrypt(uint16_t block, const uint16_t round_keys[3]) {
+        uint16_t state = (uint16_t)(block ^ round_keys[2]);
+        state = (uint16_t)(sub_nibbles(shift_rows(state), true) ^ round_keys[1]);
+        state = sub_nibbles(shift_rows(mix_columns(state, true)), true);
+        return (uint16_t)(state ^ round_keys[0]);
+    }
+
+private:
+
+    // SUB_BYTE[d][b]: S-box applied to both nibbles of byte b
+    static constexpr array<array<uint8_t, 256>, 2> SUB_BYTE = [] {
+        array<array<uint8_t, 256>, 2> table{};
+        for(int d=0; d < 2; d++){
+            for(int b=0; b < 256; b++){
+                table[d][b] = (uint8_t)((SAES_SBOX[d][b >> 4] << 4) | SAES_SBOX[d][b & 0xF]);
+            }
+        }
+        return table;
+    }();
+
+    // MIX_BYTE[d][c]: column c = (top nibble, bottom nibble) multiplied by MIX[d] in GF(2⁴)
+    static constexpr const array<array<uint8_t, 256>, 2>& MIX_BYTE = SAES_MIX_COLUMN;
+};
+
+// Compile-time test vector: key A73B, plaintext 6F6B, ciphertext 0738
+constexpr uint16_t fast_saes_test_vector(bool decrypt) {
+    uint16_t round_keys[3] = {};
+    FastSAES::expand_key(0xA73B, round_keys);
+    return decrypt ? FastSAES::decrypt(0x0738, round_keys) : FastSAES::encrypt(0x6F6B, round_keys);
+}
+
+static_assert(fast_saes_test_vector(false) == 0x0738 && fast_saes_test_vector(true) == 0x6F6B,
+              "FastSAES does not match the S-AES test vector");
+
+#endif
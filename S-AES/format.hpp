@@ -0,0 +1,384 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hex.hpp"
+#include "base64.hpp"
+#include "util.hpp"
+
+using namespace std;
+
+#ifndef FORMAT_HPP
+#define FORMAT_HPP
+
+/**
+ * @brief Encodings accepted for input and output data: raw bytes, hexadecimal or Base64 text.
+ */
+enum class Format { RAW, HEX, BASE64 };
+
+/**
+ * @brief Parses a format name ("raw", "hex", "base64" or "b64").
+ *
+ * @throws invalid_argument for an unknown name.
+ */
+inline Format parse_format(const string& name) {
+    if(name == "raw") return Format::RAW;
+    if(name == "hex") return Format::HEX;
+    if(name == "base64" || name == "b64") return Format::BASE64;
+    throw invalid_argument("unknown format: " + name);
+}
+
+inline const char* format_name(Format format) {
+    const char* names[] = {"raw", "hex", "base64"};
+    return names[(int)format];
+}
+
+/**
+ * @class FormatDecoder
+ * @brief Incremental decoder turning text chunks of any size into bytes.
+ *
+ * @details Text is decoded in groups (2 hex digits or 4 Base64 characters giving 1 or 3 bytes).
+ * The characters of a group split across two chunks are carried over to the next call, so the
+ * input can be cut anywhere. Line breaks (and the spaces or '\r' ending a line) are skipped, so
+ * text files such as the messages/ corpus can be read as they are. Base64 must end with its
+ * '=' padding (see Base64). Raw data is copied unchanged.
+ */
+class FormatDecoder {
+public:
+
+    Format format;
+
+    explicit FormatDecoder(Format format_) : format(format_) {}
+
+    /**
+     * @brief Returns the number of characters of a group (1 for raw data).
+     */
+    size_t group_chars() const {
+        return format == Format::BASE64 ? 4 : format == Format::HEX ? 2 : 1;
+    }
+
+    /**
+     * @brief Returns the number of bytes decoded from a complete group.
+     */
+    size_t group_bytes() const {
+        return format == Format::BASE64 ? 3 : 1;
+    }
+
+    /**
+     * @brief Returns the number of characters waiting for the rest of their group.
+     */
+    size_t pending() const {
+        return carried;
+    }
+
+    /**
+     * @brief Tells whether Base64 padding was seen (nothing but line breaks may follow).
+     */
+    bool ended() const {
+        return padded;
+    }
+
+    /**
+     * @brief Returns an upper bound of the bytes produced by update() for 'size' more characters.
+     */
+    size_t max_decoded(size_t size) const {
+        return (carried + size) / group_chars() * group_bytes();
+    }
+
+    /**
+     * @brief Decodes 'size' characters into 'out', which must hold max_decoded(size) bytes.
+     *
+     * @return The number of bytes written.
+     * @throws invalid_argument on a character outside the format's alphabet.
+     */
+    size_t update(const char* in, size_t size, uint8_t* out) {
+        if(format == Format::RAW){
+            memcpy(out, in, size);
+            return size;
+        }
+        uint8_t* start = out;
+        while(size > 0){
+            const char* newline = (const char*)memchr(in, '\n', size);
+            size_t line = newline ? (size_t)(newline - in) : size;
+            size_t text = line;
+            while(text > 0 && (in[text - 1] == '\r' || in[text - 1] == ' ' || in[text - 1] == '\t')) text--;
+            out += decode_run(in, text, out);
+            if(newline) line++;
+            in += line;
+            size -= line;
+        }
+        return (size_t)(out - start);
+    }
+
+    /**
+     * @brief Checks that the input did not end in the middle of a group.
+     *
+     * @param out Unused: every group is decoded as soon as it is complete (Base64 must be padded).
+     * @return The number of bytes written (always 0).
+     * @throws invalid_argument if the input ends in the middle of a group.
+     */
+    size_t finish(uint8_t* out) {
+        (void)out;
+        size_t size = carried;
+        carried = 0;
+        if(size == 0) return 0;
+        if(format == Format::HEX) throw invalid_argument("odd number of hex digits");
+        throw invalid_argument("invalid base64 length (input ends with " + to_string(size) + " characters of a group)");
+    }
+
+private:
+
+    char carry[4];
+    size_t carried = 0;
+    bool padded = false;
+
+    // Decodes a run of characters without line breaks, completing the carried group first
+    size_t decode_run(const char* in, size_t size, uint8_t* out) {
+        if(size == 0) return 0;
+        if(padded) throw invalid_argument("data after base64 padding");
+        size_t group = group_chars(), produced = 0;
+        if(carried > 0){
+            size_t take = min(size, group - carried);
+            memcpy(carry + carried, in, take);
+            carried += take;
+            in += take;
+            size -= take;
+            if(carried < group) return 0;
+            produced = decode_groups(carry, group, out);
+            carried = 0;
+        }
+        size_t whole = size / group * group;
+        produced += decode_groups(in, whole, out + produced);
+        carried = size - whole;
+        memcpy(carry, in + whole, carried);
+        return produced;
+    }
+
+    size_t decode_groups(const char* in, size_t size, uint8_t* out) {
+        if(size == 0) return 0;
+        if(format == Format::HEX) return Hex::decode(in, size, out);
+        if(padded) throw invalid_argument("data after base64 padding");
+        padded = in[size - 1] == '=';
+        return Base64::decode(in, size, out);
+    }
+};
+
+/**
+ * @class FormatEncoder
+ * @brief Incremental encoder turning byte chunks of any size into text.
+ *
+ * @details Base64 encodes whole groups of 3 bytes and carries the remaining 1 or 2 bytes to the
+ * next call; finish() pads them. Text formats end with a newline, like the messages/ corpus.
+ */
+class FormatEncoder {
+public:
+
+    Format format;
+
+    explicit FormatEncoder(Format format_) : format(format_) {}
+
+    /**
+     * @brief Returns an upper bound of the characters produced by update() for 'size' more bytes.
+     */
+    size_t max_encoded(size_t size) const {
+        if(format == Format::BASE64) return Base64::encoded_length(carried + size);
+        return format == Format::HEX ? Hex::encoded_length(size) : size;
+    }
+
+    /**
+     * @brief Encodes 'size' bytes into 'out', which must hold max_encoded(size) characters.
+     *
+     * @return The number of characters written.
+     */
+    size_t update(const uint8_t* in, size_t size, char* out) {
+        if(format == Format::RAW){
+            memcpy(out, in, size);
+            return size;
+        }
+        if(format == Format::HEX){
+            Hex::encode(in, size, out);
+            return Hex::encoded_length(size);
+        }
+        char* start = out;
+        if(carried > 0){
+            size_t take = min(size, 3 - carried);
+            memcpy(carry + carried, in, take);
+            carried += take;
+            in += take;
+            size -= take;
+            if(carried < 3) return 0;
+            Base64::encode(carry, 3, out);
+            out += 4;
+            carried = 0;
+        }
+        size_t whole = size / 3 * 3;
+        Base64::encode(in, whole, out);
+        out += Base64::encoded_length(whole);
+        carried = size - whole;
+        memcpy(carry, in + whole, carried);
+        return (size_t)(out - start);
+    }
+
+    /**
+     * @brief Writes the end of the text: the padded last Base64 group and a newline.
+     *
+     * @param out Room for 5 characters.
+     * @return The number of characters written.
+     */
+    size_t finish(char* out) {
+        if(format == Format::RAW) return 0;
+        size_t size = Base64::encoded_length(carried);
+        Base64::encode(carry, carried, out);
+        carried = 0;
+        out[size] = '\n';
+        return size + 1;
+    }
+
+private:
+
+    uint8_t carry[3];
+    size_t carried = 0;
+};
+
+/**
+ * @class FormatReader
+ * @brief Reads a stream in any format and decodes it straight into the caller's byte buffer.
+ *
+ * @details Raw data is read directly into the buffer; text is read in chunks of at most
+ * 'text_chunk' characters, sized so that their decoded bytes fit in the space requested, and
+ * decoded in one pass into the buffer, where the cipher then works in place.
+ * The source is either a std::istream or a POSIX file descriptor (stdin, pipes...).
+ */
+class FormatReader {
+public:
+
+    static const size_t TEXT_CHUNK = 1 << 16;
+
+    FormatReader(istream& in_, Format format, size_t text_chunk = TEXT_CHUNK)
+        : in(&in_), decoder(format), text(format == Format::RAW ? 0 : max<size_t>(text_chunk, 4)) {}
+
+    FormatReader(int fd_, Format format, size_t text_chunk = TEXT_CHUNK)
+        : fd(fd_), decoder(format), text(format == Format::RAW ? 0 : max<size_t>(text_chunk, 4)) {}
+
+    /**
+     * @brief Returns the granularity of read sizes (3 bytes for Base64, 1 otherwise).
+     */
+    size_t granularity() const {
+        return decoder.group_bytes();
+    }
+
+    /**
+     * @brief Decodes up to 'size' bytes into 'out'.
+     *
+     * @param out The destination buffer.
+     * @param size Space available, a non-zero multiple of granularity().
+     * @return The number of bytes written, 0 only at the end of the input.
+     * @throws invalid_argument on malformed text, runtime_error on a read error.
+     */
+    size_t read(uint8_t* out, size_t size) {
+        assert(size > 0 && (size % granularity() == 0 || finished || decoder.ended()));
+        if(decoder.format == Format::RAW) return read_stream((char*)out, size);
+
+        while(!finished){
+            size_t chars = text.size();
+            if(!decoder.ended()) chars = min(chars, size / decoder.group_bytes() * decoder.group_chars() - decoder.pending());
+            chars = read_stream(text.data(), chars);
+            if(chars == 0){
+                finished = true;
+                return decoder.finish(out);
+            }
+            size_t produced = decoder.update(text.data(), chars, out);
+            if(produced > 0) return produced;
+        }
+        return 0;
+    }
+
+private:
+
+    istream* in = nullptr;
+    int fd = -1;
+    FormatDecoder decoder;
+    vector<char> text;
+    bool finished = false;
+
+    size_t read_stream(char* buffer, size_t size) {
+        if(!in) return read_full(fd, (uint8_t*)buffer, size);
+        Instrument::Timer timer(Instrument::IO_READ);
+        in->read(buffer, size);
+        if(in->bad()) throw runtime_error("error reading input stream");
+        return (size_t)in->gcount();
+    }
+};
+
+/**
+ * @class FormatWriter
+ * @brief Encodes bytes in any format and writes them to a stream.
+ *
+ * @details Raw data is written directly; text goes through a buffer of at most 'text_chunk'
+ * characters. finish() must be called once after the last write. The destination is either a
+ * std::ostream or a POSIX file descriptor.
+ */
+class FormatWriter {
+public:
+
+    static const size_t TEXT_CHUNK = 1 << 16;
+
+    FormatWriter(ostream& out_, Format format, size_t text_chunk = TEXT_CHUNK)
+        : out(&out_), encoder(format), text(format == Format::RAW ? 0 : max<size_t>(text_chunk, 16)) {}
+
+    FormatWriter(int fd_, Format format, size_t text_chunk = TEXT_CHUNK)
+        : fd(fd_), encoder(format), text(format == Format::RAW ? 0 : max<size_t>(text_chunk, 16)) {}
+
+    /**
+     * @brief Encodes and writes 'size' bytes.
+     *
+     * @throws runtime_error on a write error.
+     */
+    void write(const uint8_t* data, size_t size) {
+        if(encoder.format == Format::RAW){
+            write_stream((const char*)data, size);
+            return;
+        }
+        // Bytes per piece so that the encoded text (plus a carried Base64 group) fits in the buffer
+        size_t piece = encoder.format == Format::HEX ? text.size() / 2 : text.size() / 4 * 3 - 3;
+        for(size_t done=0; done < size; ){
+            size_t length = min(piece, size - done);
+            write_stream(text.data(), encoder.update(data + done, length, text.data()));
+            done += length;
+        }
+    }
+
+    /**
+     * @brief Writes the end of the encoded text and flushes the stream.
+     */
+    void finish() {
+        char tail[8];
+        write_stream(tail, encoder.finish(tail));
+        if(!out) return;
+        out->flush();
+        if(!*out) throw runtime_error("error writing output stream");
+    }
+
+private:
+
+    ostream* out = nullptr;
+    int fd = -1;
+    FormatEncoder encoder;
+    vector<char> text;
+
+    void write_stream(const char* buffer, size_t size) {
+        if(!out) return write_full(fd, (const uint8_t*)buffer, size);
+        Instrument::Timer timer(Instrument::IO_WRITE);
+        out->write(buffer, size);
+        if(!*out) throw runtime_error("error writing output stream");
+    }
+};
+
+#endif
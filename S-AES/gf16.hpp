@@ -1,3 +1,6 @@
+#include <array>
+#include <cstdint>
+
 using namespace std;
 
 #ifndef GF16
@@ -14,6 +17,9 @@ using namespace std;
  *
  * Addition in GF(2^4) corresponds to bitwise XOR.
  * Multiplication is polynomial multiplication modulo the primitive polynomial.
+ *
+ * Every operation is constexpr, so the tables below (multiplication, inverse, S-boxes and MixColumns)
+ * are generated entirely at compile time and no field arithmetic is left on the hot path.
  */
 struct GF_16 {
     /**
@@ -22,7 +28,7 @@ struct GF_16 {
      * @param x Polynomial to reduce, possibly up to degree 6 (bits beyond 3).
      * @return The reduced polynomial as an integer within GF(2^4) (4 bits).
      */
-    int mod(int x) {
+    static constexpr int mod(int x) {
         // Start with the part of x that already fits in GF(16) (degree ≤ 3)
         int ans = x & 0b1111;  // Keep lower 4 bits
 
@@ -45,7 +51,7 @@ struct GF_16 {
      * @param y Second polynomial operand (4-bit integer).
      * @return The product modulo the primitive polynomial as a 4-bit integer.
     */
-    int mul(int x, int y) {
+    static constexpr int mul(int x, int y) {
         int ans = 0;
 
         // Multiply polynomials as binary numbers (shift and XOR)
@@ -58,6 +64,104 @@ struct GF_16 {
         // Reduce the result modulo the primitive polynomial
         return mod(ans);
     }
+
+    /**
+     * @brief Computes the multiplicative inverse of an element of GF(2^4).
+     *
+     * @details Uses x⁻¹ = x¹⁴, since the multiplicative group has order 15. By convention 0⁻¹ = 0,
+     * as in the S-AES S-box construction.
+     *
+     * @param x The element to invert (4-bit integer).
+     * @return The inverse of x (0 when x is 0).
+     */
+    static constexpr int inv(int x) {
+        int ans = 1;
+        for (int i = 0; i < 14; i++) ans = mul(ans, x);
+        return x == 0 ? 0 : ans;
+    }
+
+    /**
+     * @brief Applies the S-AES S-box to a nibble: inversion in GF(2^4) followed by an affine map over GF(2).
+     *
+     * @details The inverse b = x⁻¹ is multiplied (bits taken most significant first) by the matrix
+     *      1 0 1 1
+     *      1 1 0 1
+     *      1 1 1 0
+     *      0 1 1 1
+     * and the constant 1001 is added.
+     *
+     * @param x The input nibble.
+     * @return The substituted nibble.
+     */
+    static constexpr int sbox(int x) {
+        const int rows[4] = {0b1011, 0b1101, 0b1110, 0b0111};
+        int b = inv(x), ans = 0;
+        for (int i = 0; i < 4; i++) {
+            int bit = 0;
+            for (int j = 0; j < 4; j++) bit ^= ((b & rows[i]) >> j) & 1;
+            ans = (ans << 1) | bit;
+        }
+        return ans ^ 0b1001;
+    }
 };
 
+// GF16_MUL[x][y] = x * y in GF(2^4)
+inline constexpr array<array<uint8_t, 16>, 16> GF16_MUL = [] {
+    array<array<uint8_t, 16>, 16> table{};
+    for (int x = 0; x < 16; x++)
+        for (int y = 0; y < 16; y++) table[x][y] = (uint8_t)GF_16::mul(x, y);
+    return table;
+}();
+
+// GF16_INV[x] = x⁻¹ in GF(2^4), with GF16_INV[0] = 0
+inline constexpr array<uint8_t, 16> GF16_INV = [] {
+    array<uint8_t, 16> table{};
+    for (int x = 0; x < 16; x++) table[x] = (uint8_t)GF_16::inv(x);
+    return table;
+}();
+
+// Row 0: encryption S-box | Row 1: decryption S-box (inverse permutation of row 0)
+inline constexpr array<array<uint8_t, 16>, 2> SAES_SBOX = [] {
+    array<array<uint8_t, 16>, 2> table{};
+    for (int x = 0; x < 16; x++) {
+        table[0][x] = (uint8_t)GF_16::sbox(x);
+        table[1][table[0][x]] = (uint8_t)x;
+    }
+    return table;
+}();
+
+// MixColumns matrices in GF(2⁴) | Row 0: encryption | Row 1: decryption
+inline constexpr uint8_t SAES_MIX[2][2][2] = {
+    {{1, 4}, {4, 1}},
+    {{9, 2}, {2, 9}}
+};
+
+// SAES_MIX_COLUMN[d][c]: column c = (top nibble, bottom nibble) multiplied by SAES_MIX[d]
+inline constexpr array<array<uint8_t, 256>, 2> SAES_MIX_COLUMN = [] {
+    array<array<uint8_t, 256>, 2> table{};
+    for (int d = 0; d < 2; d++) {
+        for (int c = 0; c < 256; c++) {
+            int top = GF16_MUL[SAES_MIX[d][0][0]][c >> 4] ^ GF16_MUL[SAES_MIX[d][0][1]][c & 0xF];
+            int bottom = GF16_MUL[SAES_MIX[d][1][0]][c >> 4] ^ GF16_MUL[SAES_MIX[d][1][1]][c & 0xF];
+            table[d][c] = (uint8_t)((top << 4) | bottom);
+        }
+    }
+    return table;
+}();
+
+// Compile-time checks of the generated tables
+constexpr bool gf16_tables_are_consistent() {
+    for (int x = 1; x < 16; x++)
+        if (GF16_MUL[x][GF16_INV[x]] != 1) return false;
+    for (int x = 0; x < 16; x++)
+        if (SAES_SBOX[1][SAES_SBOX[0][x]] != x || SAES_SBOX[0][SAES_SBOX[1][x]] != x) return false;
+    for (int c = 0; c < 256; c++)
+        if (SAES_MIX_COLUMN[1][SAES_MIX_COLUMN[0][c]] != c) return false;
+    return true;
+}
+
+static_assert(gf16_tables_are_consistent(), "GF(2^4) inverse, S-box or MixColumns tables do not invert");
+static_assert(SAES_SBOX[0][0] == 9 && SAES_SBOX[0][15] == 7 && SAES_SBOX[1][0] == 10 && SAES_SBOX[1][15] == 14,
+              "S-box does not match the S-AES specification");
+
 #endif
@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <span>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+
+#include "instrument.hpp"
+#include "buffer-pool.hpp"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define HEX_AVX2 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+#ifndef HEX_HPP
+#define HEX_HPP
+
+/**
+ * @class Hex
+ * @brief Provides static methods to encode and decode hexadecimal strings.
+ *
+ * @details Same layout as Base64: encode / decode work on raw buffers written in place, with a
+ * table-driven scalar path and, on CPUs with AVX2, a vectorized path handling 16 bytes
+ * (32 digits) per step. Encoding produces lowercase digits; decoding accepts both cases and
+ * rejects any other character.
+ */
+class Hex {
+public:
+
+    static inline const string digits = "0123456789abcdef";
+
+    /**
+     * @brief Returns the number of digits encoding 'size' bytes.
+     */
+    static size_t encoded_length(size_t size) {
+        return 2 * size;
+    }
+
+    /**
+     * @brief Returns the number of bytes encoded by 'size' digits.
+     *
+     * @throws invalid_argument if the number of digits is odd.
+     */
+    static size_t decoded_length(size_t size) {
+        if(size % 2 != 0) throw invalid_argument("odd number of hex digits");
+        return size / 2;
+    }
+
+    /**
+     * @brief Encodes 'size' bytes into 2 * size digits written to 'out'.
+     */
+    static void encode(const uint8_t* in, size_t size, char* out) {
+        Instrument::Timer timer(Instrument::HEX_ENCODE);
+        size_t i = 0;
+#ifdef HEX_AVX2
+        if(has_avx2()) i = encode_avx2(in, size, out);
+#endif
+        for(; i < size; i++){
+            out[2 * i] = digits[in[i] >> 4];
+            out[2 * i + 1] = digits[in[i] & 15];
+        }
+    }
+
+    /**
+     * @brief Decodes 'size' digits into 'out', which must hold size / 2 bytes.
+     *
+     * @return The number of bytes written.
+     * @throws invalid_argument on an odd number of digits or a character that is not a hex digit.
+     */
+    static size_t decode(const char* in, size_t size, uint8_t* out) {
+        Instrument::Timer timer(Instrument::HEX_DECODE);
+        size_t bytes = decoded_length(size), i = 0;
+#ifdef HEX_AVX2
+        if(has_avx2()) i = decode_avx2(in, bytes, out);
+#endif
+        for(; i < bytes; i++){
+            int n = value(in[2 * i]) << 4 | value(in[2 * i + 1]);
+            if(n < 0) throw invalid_argument("invalid hex digit");
+            out[i] = (uint8_t)n;
+        }
+        return bytes;
+    }
+
+    /**
+     * @brief Converts a sequence of bytes into a lowercase hexadecimal string.
+     *
+     * @param bytes A sequence of bytes (vector<int> with values 0 to 255, vector<uint8_t>, span...).
+     */
+    template<class Bytes>
+    static string convert_to(const Bytes& bytes) {
+        if constexpr (is_convertible_v<const Bytes&, span<const uint8_t>>) {
+            span<const uint8_t> data = bytes;
+            Instrument::count(Instrument::ALLOCATIONS);
+            string output(encoded_length(data.size()), '\0');
+            encode(data.data(), data.size(), output.data());
+            return output;
+        } else {
+            BufferPool::Buffer data(bytes.size());
+            copy(bytes.begin(), bytes.end(), data.data());
+            return convert_to(span<const uint8_t>(data));
+        }
+    }
+
+    /**
+     * @brief Encodes bytes into 'output', reusing its capacity (no allocation once it is large enough).
+     */
+    static void convert_to(span<const uint8_t> bytes, string& output) {
+        BufferPool::resize(output, encoded_length(bytes.size()));
+        encode(bytes.data(), bytes.size(), output.data());
+    }
+
+    /**
+     * @brief Decodes a hexadecimal string into a vector of bytes.
+     *
+     * @throws invalid_argument on an odd number of digits or a character that is not a hex digit.
+     */
+    static vector<uint8_t> decode(const string& input) {
+        vector<uint8_t> bytes;
+        decode(input, bytes);
+        return bytes;
+    }
+
+    /**
+     * @brief Decodes a hexadecimal string into 'output' (a string or byte vector), reusing its capacity.
+     *
+     * @throws invalid_argument as decode(const string&).
+     */
+    template<class Output>
+    static void decode(string_view input, Output& output) {
+        BufferPool::resize(output, decoded_length(input.size()));
+        decode(input.data(), input.size(), (uint8_t*)output.data());
+    }
+
+private:
+
+    // Value of every character, -1 for non-digits
+    static constexpr array<int8_t, 256> VALUES = [] {
+        array<int8_t, 256> values{};
+        for(auto &v : values) v = -1;
+        for(int i=0; i < 10; i++) values['0' + i] = (int8_t)i;
+        for(int i=0; i < 6; i++) values['a' + i] = values['A' + i] = (int8_t)(10 + i);
+        return values;
+    }();
+
+    static int value(char c) {
+        return VALUES[(uint8_t)c];
+    }
+
+#ifdef HEX_AVX2
+    static bool has_avx2() {
+        static const bool avx2 = [] {
+            __builtin_cpu_init();
+            return (bool)__builtin_cpu_supports("avx2");
+        }();
+        return avx2;
+    }
+
+    /*  Encodes 16 bytes into 32 digits per step: the nibbles are interleaved in output order and
+        translated by a pshufb lookup in the digit table. Returns the number of bytes consumed.
+    */
+    __attribute__((target("avx2")))
+    static size_t encode_avx2(const uint8_t* in, size_t size, char* out) {
+        const __m256i table = _mm256_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f',
+                                               '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+        const __m128i low_nibble = _mm_set1_epi8(0x0F);
+        size_t i = 0;
+        for(; i + 16 <= size; i += 16){
+            __m128i bytes = _mm_loadu_si128((const __m128i*)(in + i));
+            __m128i hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), low_nibble);
+            __m128i lo = _mm_and_si128(bytes, low_nibble);
+            __m256i nibbles = _mm256_setr_m128i(_mm_unpacklo_epi8(hi, lo), _mm_unpackhi_epi8(hi, lo));
+            _mm256_storeu_si256((__m256i*)(out + 2 * i), _mm256_shuffle_epi8(table, nibbles));
+        }
+        return i;
+    }
+
+    /*  Decodes 32 digits into 16 bytes per step. Digits and letters are recognized with unsigned
+        range checks (c - '0' <= 9, (c | 0x20) - 'a' <= 5), then each pair of nibbles is merged
+        with a multiply-add. Returns the number of bytes written.
+    */
+    __attribute__((target("avx2")))
+    static size_t decode_avx2(const char* in, size_t bytes, uint8_t* out) {
+        size_t i = 0;
+        for(; i + 16 <= bytes; i += 16){
+            __m256i chars = _mm256_loadu_si256((const __m256i*)(in + 2 * i));
+            __m256i digit = _mm256_sub_epi8(chars, _mm256_set1_epi8('0'));
+            __m256i letter = _mm256_sub_epi8(_mm256_or_si256(chars, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+            __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+            __m256i is_letter = _mm256_cmpeq_epi8(_mm256_min_epu8(letter, _mm256_set1_epi8(5)), letter);
+            if(_mm256_movemask_epi8(_mm256_or_si256(is_digit, is_letter)) != -1) throw invalid_argument("invalid hex digit");
+
+            __m256i nibbles = _mm256_blendv_epi8(_mm256_add_epi8(letter, _mm256_set1_epi8(10)), digit, is_digit);
+            __m256i words = _mm256_maddubs_epi16(nibbles, _mm256_set1_epi16(0x0110));
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(words, words), 0x08);
+            _mm_storeu_si128((__m128i*)(out + i), _mm256_castsi256_si128(packed));
+        }
+        return i;
+    }
+#endif
+
+};
+
+#endif
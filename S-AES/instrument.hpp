@@ -0,0 +1,249 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define INSTRUMENT_RDTSC 1
+#endif
+
+using namespace std;
+
+#ifndef INSTRUMENT_HPP
+#define INSTRUMENT_HPP
+
+// Compile with -DSAES_INSTRUMENT=1 to enable the counters and stage timers
+#ifndef SAES_INSTRUMENT
+#define SAES_INSTRUMENT 0
+#endif
+
+/**
+ * @class Instrument
+ * @brief Compile-time switchable counters and per-stage timers for the cipher and codec hot paths.
+ *
+ * @details When SAES_INSTRUMENT is 0 (the default) every hook is an empty inline function or an
+ * empty object and compiles to nothing. When it is 1:
+ * - count() adds to an event counter (blocks, bytes, key expansions, allocations),
+ * - a Timer object adds the time elapsed during its lifetime to a stage (TSC cycles on x86,
+ *   nanoseconds elsewhere) and counts the call.
+ *
+ * Each thread writes to its own slab of counters (plain relaxed loads and stores, no atomic
+ * read-modify-write and no shared cache line), so the hooks stay cheap in multithreaded runs;
+ * slabs outlive their threads and are summed when a summary or JSON export is requested.
+ * Stage timers wrap whole calls: a mode's encrypt/decrypt (cipher), a pass of the bitsliced kernel
+ * (bitsliced), a key-search batch (key_search), a Base64 buffer, an I/O request. The packed and
+ * bitsliced engines run a full block in a few nanoseconds, so the round steps (sub_nibbles to
+ * expand_key) are only timed on the round-by-round reference path, i.e. for traced blocks and
+ * the SAES reference functions; production runs show up in cipher and bitsliced.
+ */
+class Instrument {
+public:
+
+    static constexpr bool enabled = SAES_INSTRUMENT != 0;
+
+    enum Counter { BLOCKS, BYTES, KEY_EXPANSIONS, ALLOCATIONS, COUNTERS };
+
+    enum Stage {
+        SUB_NIBBLES, SHIFT_ROWS, MIX_COLUMNS, ADD_ROUND_KEY, EXPAND_KEY,   // Reference path only
+        CIPHER, BITSLICED, KEY_SEARCH,
+        BASE64_ENCODE, BASE64_DECODE, HEX_ENCODE, HEX_DECODE, IO_READ, IO_WRITE, STAGES
+    };
+
+    /**
+     * @brief Adds 'n' to an event counter of the calling thread.
+     */
+    static void count(Counter counter, uint64_t n = 1) {
+        if constexpr (enabled) add(local().counters[counter], n);
+    }
+
+    /**
+     * @brief Counts the blocks and bytes of a cipher call on 'bytes' bytes.
+     */
+    static void count_bytes(uint64_t bytes) {
+        if constexpr (enabled) {
+            Slab& slab = local();
+            add(slab.counters[BYTES], bytes);
+            add(slab.counters[BLOCKS], (bytes + 1) / 2);
+        }
+    }
+
+    /**
+     * @class Timer
+     * @brief Adds the time between its construction and destruction to a stage.
+     */
+    class Timer {
+    public:
+
+        explicit Timer(Stage stage_) {
+            if constexpr (enabled) {
+                stage = stage_;
+                start = ticks();
+            }
+        }
+
+        ~Timer() {
+            if constexpr (enabled) {
+                Slab& slab = local();
+                add(slab.stage_ticks[stage], ticks() - start);
+                add(slab.stage_calls[stage], 1);
+            }
+        }
+
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+    private:
+
+        Stage stage = STAGES;
+        uint64_t start = 0;
+    };
+
+    /**
+     * @brief Totals of all threads.
+     */
+    struct Snapshot {
+        uint64_t counters[COUNTERS] = {};
+        uint64_t stage_ticks[STAGES] = {};
+        uint64_t stage_calls[STAGES] = {};
+    };
+
+    /**
+     * @brief Sums the counters of every thread.
+     */
+    static Snapshot snapshot() {
+        Snapshot total;
+        lock_guard<mutex> lock(registry_mutex());
+        for(const Slab& slab : registry()){
+            for(int c=0; c < COUNTERS; c++) total.counters[c] += slab.counters[c].load(memory_order_relaxed);
+            for(int s=0; s < STAGES; s++){
+                total.stage_ticks[s] += slab.stage_ticks[s].load(memory_order_relaxed);
+                total.stage_calls[s] += slab.stage_calls[s].load(memory_order_relaxed);
+            }
+        }
+        return total;
+    }
+
+    /**
+     * @brief Clears the counters of every thread (meant to be called while no hook is running).
+     */
+    static void reset() {
+        lock_guard<mutex> lock(registry_mutex());
+        for(Slab& slab : registry()){
+            for(auto &c : slab.counters) c.store(0, memory_order_relaxed);
+            for(auto &t : slab.stage_ticks) t.store(0, memory_order_relaxed);
+            for(auto &n : slab.stage_calls) n.store(0, memory_order_relaxed);
+        }
+    }
+
+    static const char* counter_name(Counter counter) {
+        const char* names[] = {"blocks", "bytes", "key_expansions", "allocations"};
+        return names[counter];
+    }
+
+    static const char* stage_name(Stage stage) {
+        const char* names[] = {
+            "sub_nibbles", "shift_rows", "mix_columns", "add_round_key", "expand_key",
+            "cipher", "bitsliced", "key_search",
+            "base64_encode", "base64_decode", "hex_encode", "hex_decode", "io_read", "io_write"
+        };
+        return names[stage];
+    }
+
+    /**
+     * @brief Returns the unit of the stage times: "cycles" (TSC) or "ns".
+     */
+    static const char* tick_unit() {
+#ifdef INSTRUMENT_RDTSC
+        return "cycles";
+#else
+        return "ns";
+#endif
+    }
+
+    /**
+     * @brief Formats the totals as a human-readable table.
+     */
+    static string summary() {
+        if(!enabled) return "instrumentation disabled (build with -DSAES_INSTRUMENT=1)\n";
+        Snapshot total = snapshot();
+        string text;
+        char line[128];
+        for(int c=0; c < COUNTERS; c++){
+            snprintf(line, sizeof(line), "%-16s %16llu\n", counter_name((Counter)c), (unsigned long long)total.counters[c]);
+            text += line;
+        }
+        snprintf(line, sizeof(line), "\n%-16s %12s %16s %12s\n", "stage", "calls", tick_unit(), "per call");
+        text += line;
+        for(int s=0; s < STAGES; s++){
+            if(total.stage_calls[s] == 0) continue;
+            snprintf(line, sizeof(line), "%-16s %12llu %16llu %12.1f\n", stage_name((Stage)s),
+                     (unsigned long long)total.stage_calls[s], (unsigned long long)total.stage_ticks[s],
+                     (double)total.stage_ticks[s] / total.stage_calls[s]);
+            text += line;
+        }
+        return text + "\n(sub_nibbles to expand_key time the reference path only: traced blocks and SAES::*_reference)\n";
+    }
+
+    /**
+     * @brief Formats the totals as a JSON object.
+     */
+    static string json() {
+        Snapshot total = snapshot();
+        string text = string("{\"enabled\": ") + (enabled ? "true" : "false") + ", \"unit\": \"" + tick_unit() + "\", \"counters\": {";
+        for(int c=0; c < COUNTERS; c++){
+            text += string(c ? ", " : "") + "\"" + counter_name((Counter)c) + "\": " + to_string(total.counters[c]);
+        }
+        text += "}, \"stages\": {";
+        for(int s=0; s < STAGES; s++){
+            text += string(s ? ", " : "") + "\"" + stage_name((Stage)s) + "\": {\"calls\": " + to_string(total.stage_calls[s])
+                  + ", \"ticks\": " + to_string(total.stage_ticks[s]) + "}";
+        }
+        return text + "}}\n";
+    }
+
+private:
+
+    struct Slab {
+        atomic<uint64_t> counters[COUNTERS] = {};
+        atomic<uint64_t> stage_ticks[STAGES] = {};
+        atomic<uint64_t> stage_calls[STAGES] = {};
+    };
+
+    // Single writer per slab: a relaxed load and store, readable concurrently by snapshot()
+    static void add(atomic<uint64_t>& value, uint64_t n) {
+        value.store(value.load(memory_order_relaxed) + n, memory_order_relaxed);
+    }
+
+    static uint64_t ticks() {
+#ifdef INSTRUMENT_RDTSC
+        return __rdtsc();
+#else
+        return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    static mutex& registry_mutex() {
+        static mutex m;
+        return m;
+    }
+
+    // Slabs of all threads that ever used a hook (never freed: totals survive their threads)
+    static deque<Slab>& registry() {
+        static deque<Slab> slabs;
+        return slabs;
+    }
+
+    static Slab& local() {
+        thread_local Slab* slab = [] {
+            lock_guard<mutex> lock(registry_mutex());
+            return &registry().emplace_back();
+        }();
+        return *slab;
+    }
+};
+
+#endif
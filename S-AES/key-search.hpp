@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "bitslice.hpp"
+#include "thread-pool.hpp"
+
+using namespace std;
+
+#ifndef KEY_SEARCH_HPP
+#define KEY_SEARCH_HPP
+
+/**
+ * @brief A known plaintext block and the ciphertext block it encrypts to.
+ */
+struct KnownPair {
+    uint16_t plaintext;
+    uint16_t ciphertext;
+};
+
+/**
+ * @class KeySearch
+ * @brief Exhaustive known-plaintext key recovery over the 65,536 S-AES keys.
+ *
+ * @details Keys are tested by the bitsliced engine with one key per lane (see
+ * BitslicedSAES::search_keys): the 16-bit key space is only 128 to 1024 kernel passes, and the
+ * additional pairs that filter false positives cost nothing for batches already ruled out by the
+ * first one. A single pair leaves about one wrong key on average next to the right one; each
+ * further pair divides that by 65,536.
+ *
+ * With a thread pool, one search is split into ranges of keys searched concurrently, and
+ * search_all() runs independent challenges concurrently (each one serially, which is faster than
+ * splitting a microsecond-long search across threads).
+ */
+class KeySearch {
+public:
+
+    static const uint32_t KEYS = 1 << 16;
+    static const uint32_t CHUNK_KEYS = 1 << 12;   // Keys per parallel task of a single search
+
+    BitslicedSAES::ISA isa;
+
+    /**
+     * @brief Constructs a serial key search engine.
+     *
+     * @param isa_ Instruction set of the bitsliced kernel (default: the best one supported by the CPU).
+     */
+    KeySearch(BitslicedSAES::ISA isa_ = BitslicedSAES::best_isa()) : isa(isa_) {}
+
+    /**
+     * @brief Sets the number of threads used by the searches.
+     *
+     * @param threads Total number of threads (1: serial, 0: one per hardware thread).
+     */
+    void set_threads(int threads) {
+        pool = threads == 1 ? nullptr : make_shared<ThreadPool>(threads);
+    }
+
+    /**
+     * @brief Uses an existing thread pool (possibly shared with the modes of operation).
+     *
+     * @param pool_ The pool, or nullptr for serial searches.
+     */
+    void set_pool(shared_ptr<ThreadPool> pool_) {
+        pool = pool_;
+    }
+
+    /**
+     * @brief Returns every key consistent with all the known pairs.
+     *
+     * @param pairs The known (plaintext, ciphertext) pairs, all under the same key.
+     * @return The consistent keys in increasing order (empty if the pairs come from no single key).
+     * @throws invalid_argument if no pair is given.
+     */
+    vector<uint16_t> search(span<const KnownPair> pairs) const {
+        if(pairs.empty()) throw invalid_argument("key search needs at least one known pair");
+        vector<uint16_t> plaintexts, ciphertexts;
+        split(pairs, plaintexts, ciphertexts);
+
+        vector<uint16_t> keys;
+        if(!pool || pool->size() == 1){
+            BitslicedSAES::search_keys(0, KEYS, plaintexts.data(), ciphertexts.data(), pairs.size(), keys, isa);
+            return keys;
+        }
+
+        // Each range collects its own keys; ranges are concatenated in order afterwards
+        vector<vector<uint16_t>> found(KEYS / CHUNK_KEYS);
+        pool->parallel_for(found.size(), 1, [&](size_t begin, size_t end) {
+            for(size_t chunk=begin; chunk < end; chunk++){
+                BitslicedSAES::search_keys((uint32_t)chunk * CHUNK_KEYS, CHUNK_KEYS, plaintexts.data(),
+                                           ciphertexts.data(), pairs.size(), found[chunk], isa);
+            }
+        });
+        for(auto &chunk : found) keys.insert(keys.end(), chunk.begin(), chunk.end());
+        return keys;
+    }
+
+    /**
+     * @brief Solves many independent challenges, concurrently when a thread pool is set.
+     *
+     * @param challenges The known pairs of each challenge.
+     * @return The consistent keys of each challenge, in the same order.
+     * @throws invalid_argument if a challenge has no pair.
+     */
+    vector<vector<uint16_t>> search_all(span<const vector<KnownPair>> challenges) const {
+        vector<vector<uint16_t>> keys(challenges.size());
+        KeySearch serial(isa);
+        auto solve = [&](size_t begin, size_t end) {
+            for(size_t i=begin; i < end; i++) keys[i] = serial.search(challenges[i]);
+        };
+        if(pool) pool->parallel_for(challenges.size(), 16, solve);
+        else solve(0, challenges.size());
+        return keys;
+    }
+
+    /**
+     * @brief Builds known pairs from a message encrypted in ECB mode.
+     *
+     * @details Four distinct pairs already leave a wrong key a 2⁻⁴⁸ chance of surviving.
+     *
+     * @param plaintext The plaintext bytes (16-bit big-endian blocks).
+     * @param ciphertext The ciphertext bytes, at least as long as the plaintext.
+     * @param limit Maximum number of pairs returned.
+     * @return Up to 'limit' pairs with distinct plaintext blocks (an odd trailing byte is ignored).
+     */
+    static vector<KnownPair> pairs(span<const uint8_t> plaintext, span<const uint8_t> ciphertext, size_t limit = 4) {
+        vector<KnownPair> result;
+        vector<bool> seen(KEYS);
+        size_t size = min(plaintext.size(), ciphertext.size()) / 2 * 2;
+        for(size_t i=0; i < size && result.size() < limit; i += 2){
+            uint16_t block = (uint16_t)((plaintext[i] << 8) | plaintext[i + 1]);
+            if(seen[block]) continue;
+            seen[block] = true;
+            result.push_back({block, (uint16_t)((ciphertext[i] << 8) | ciphertext[i + 1])});
+        }
+        return result;
+    }
+
+private:
+
+    shared_ptr<ThreadPool> pool; // nullptr: serial searches
+
+    static void split(span<const KnownPair> pairs, vector<uint16_t>& plaintexts, vector<uint16_t>& ciphertexts) {
+        plaintexts.reserve(pairs.size());
+        ciphertexts.reserve(pairs.size());
+        for(const KnownPair& pair : pairs){
+            plaintexts.push_back(pair.plaintext);
+            ciphertexts.push_back(pair.ciphertext);
+        }
+    }
+};
+
+#endif
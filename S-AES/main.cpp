@@ -1,10 +1,18 @@
 #include "assert.h"
 
 #include "s-aes.hpp"
+#include "trace.hpp"
 #include "base64.hpp"
 #include "ecb.hpp"
+#include "stream.hpp"
+#include "mapped-file.hpp"
+#include "output-file.hpp"
+#include "format.hpp"
+#include "cli.hpp"
 #include "util.hpp"
 
+#include <fstream>
+
 void input16(int& key, int& message, bool encrypt=true, bool ecb_=false){
     int type;
     while(true){
@@ -42,15 +50,20 @@ void input16(int& key, int& message, bool encrypt=true, bool ecb_=false){
                 printf("\n");
                 return;
             case 3:
-                cout << "Enter the 16-bit key (base64, e.g., JOw=):\n-> ";
-                getline(cin, sKey);
-                vKey = Base64::convert_from(sKey);
-                key = toInt(vKey);
-                if(!ecb_){
-                    cout << "\nEnter the 16-bit (base64)" << (encrypt ? "plaintext" : "ciphertext") << ":\n-> ";
-                    getline(cin, sMessage);
-                    vMessage = Base64::convert_from(sMessage);
-                    message = toInt(vMessage);
+                try {
+                    cout << "Enter the 16-bit key (base64, e.g., JOw=):\n-> ";
+                    getline(cin, sKey);
+                    vKey = Base64::convert_from(sKey);
+                    key = toInt(vKey);
+                    if(!ecb_){
+                        cout << "\nEnter the 16-bit (base64)" << (encrypt ? "plaintext" : "ciphertext") << ":\n-> ";
+                        getline(cin, sMessage);
+                        vMessage = Base64::convert_from(sMessage);
+                        message = toInt(vMessage);
+                    }
+                } catch(const invalid_argument& e) {
+                    cout << "\nInvalid base64 (" << e.what() << ").\n\n";
+                    continue;
                 }
                 cout << endl;
                 return;
@@ -71,9 +84,22 @@ void s_aes(bool encrypt=true){
     cout << endl;
     if(choice == 'n' || choice == 'N') debug = false;
 
-    SAES saes(key, debug);
-    if(encrypt) saes.encrypt(message);
-    else saes.decrypt(message);
+    TextTraceSink steps(cout);
+    SAES saes(key, debug ? &steps : nullptr);
+
+    cout << "\n====================== S-AES - " << (encrypt ? "Encryption" : "Decryption") << " ======================\n\n";
+    cout << (encrypt ? "Plaintext:         " : "Ciphertext:        ") << toBin(message, 16) << endl;
+    cout << "Initial key:       " << toBin(key, 16) << "\n\n";
+
+    int result = encrypt ? saes.encrypt(message) : saes.decrypt(message);
+
+    cout << "-------------------------------------------------------------\n\n";
+    cout << (encrypt ? "-> Ciphertext\n\n" : "-> Plaintext\n\n");
+    cout << "Bin:               " << TextTraceSink::nibbles((uint16_t)result);
+    printf("\nHex:               %X\n", result);
+    vector<uint8_t> bytes = { (uint8_t)(result >> 8), (uint8_t)result };
+    cout << "Base64:            " << Base64::convert_to(bytes);
+    cout << "\n=============================================================\n\n";
 }
 
 void ecb(bool encrypt=true){
@@ -97,26 +123,85 @@ void ecb(bool encrypt=true){
     }
 
     ECB ecb(key);
-    if(encrypt){
-        cout << "\n====================== S-AES (ECB) - Encryption ======================\n\n";
-        cout << "Ciphertext :   " << ecb.encrypt(message);
-        cout << "\n\n======================================================================\n\n";
-    }   
-    else{
-        cout << "\n====================== S-AES (ECB) - Decryption ======================\n\n";
-        cout << "Plaintext :   " << ecb.decrypt(message);
-        cout << "\n\n======================================================================\n\n";
-    } 
+    try {
+        if(encrypt){
+            string cipherText = ecb.encrypt(message);
+            cout << "\n====================== S-AES (ECB) - Encryption ======================\n\n";
+            cout << "Ciphertext :   " << cipherText;
+            cout << "\n\n======================================================================\n\n";
+        }   
+        else{
+            string plainText = ecb.decrypt(message);
+            cout << "\n====================== S-AES (ECB) - Decryption ======================\n\n";
+            cout << "Plaintext :   " << plainText;
+            cout << "\n\n======================================================================\n\n";
+        } 
+    } catch(const exception& e) {
+        cout << "Error: " << e.what() << "\n";
+    }
+}
+
+
+void ecb_file(bool encrypt=true){
+    int key, nulll;
+    input16(key, nulll, encrypt, true);
+
+    string input_path, output_path;
+    cout << "Enter the " << (encrypt ? "plaintext" : "ciphertext") << " file path:\n-> ";
+    getline(cin, input_path);
+    cout << "\nEnter the output file path:\n-> ";
+    getline(cin, output_path);
+
+    // The plaintext side may be text (e.g. the messages/hex corpus), the ciphertext is raw bytes
+    int type;
+    cout << "\nChoose the plaintext file format:\n";
+    cout << "1 - Raw bytes\n";
+    cout << "2 - Hexadecimal\n";
+    cout << "3 - Base64\n";
+    cout << "-> ";
+    cin >> type;
+    cin.ignore();
+    Format format = type == 2 ? Format::HEX : type == 3 ? Format::BASE64 : Format::RAW;
+
+    ECB ecb(key);
+    ecb.set_threads(0);
+    try {
+        uint64_t bytes;
+        if(format == Format::RAW && MappedFile::is_regular(input_path) && MappedFile::is_mappable_output(output_path)) {
+            // Zero-copy path: the cipher runs directly between the two mappings
+            bytes = encrypt ? MappedFile::encrypt(ecb, input_path, output_path)
+                            : MappedFile::decrypt(ecb, input_path, output_path);
+        } else {
+            // Text formats, pipes, devices...: chunked streaming, decoding straight into the chunk buffer
+            if(MappedFile::same_file(input_path, output_path)) throw runtime_error("input and output must be different files");
+            ifstream input(input_path, ios::binary);
+            if(!input) throw runtime_error("could not open " + input_path);
+            // Only replaces the output once complete: no partial output (e.g. decrypted bytes with an invalid padding)
+            OutputFile output(output_path);
+            FormatReader reader(input, encrypt ? format : Format::RAW);
+            FormatWriter writer(output.descriptor(), encrypt ? Format::RAW : format);
+            bytes = encrypt ? Stream::encrypt(ecb, reader, writer) : Stream::decrypt(ecb, reader, writer);
+            output.commit();
+        }
+        cout << "\n" << (encrypt ? "Encrypted " : "Decrypted ") << bytes << " bytes into " << output_path << "\n";
+    } catch(const exception& e) {
+        cout << "\nError: " << e.what() << "\n";
+    }
 }
 
 
-int main(){
+int main(int argc, char** argv){
+    // Any argument selects the non-interactive command line (see cli.hpp)
+    if(argc > 1) return CommandLine::run(argc, argv);
+
     while (true) {
         cout << "-------------- S-AES ------------------\n\n";
         cout << "1 - Encrypt 16-bit block with S-AES\n";
         cout << "2 - Decrypt 16-bit block with S-AES\n";
         cout << "3 - Encrypt full message (ECB)\n";
         cout << "4 - Decrypt full message (ECB)\n";
+        cout << "5 - Encrypt file (ECB)\n";
+        cout << "6 - Decrypt file (ECB)\n";
         cout << "0 - Exit\n\nChoose an option: ";
         int op;
         cin >> op;
@@ -127,6 +212,8 @@ int main(){
             case 2: s_aes(false); break;
             case 3: ecb(); break;
             case 4: ecb(false); break;
+            case 5: ecb_file(); break;
+            case 6: ecb_file(false); break;
             case 0: return 0;
             default: cout << "Invalid option.\n";
         }
@@ -0,0 +1,226 @@
+#include <cstdint>
+#include <cstddef>
+#include <cerrno>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "output-file.hpp"
+#include "padding.hpp"
+
+using namespace std;
+
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+/**
+ * @class MappedFile
+ * @brief RAII wrapper around a memory-mapped file, used for zero-copy bulk encryption.
+ *
+ * @details The input file is mapped read-only and the output (an OutputFile, which only replaces
+ * the destination once complete) is sized with ftruncate and mapped read-write; the cipher then reads from one mapping and writes into the other directly,
+ * with no read()/write() calls or userspace buffers in between. The mappings are advised as
+ * sequential (the kernel reads ahead aggressively and drops pages behind) and, optionally,
+ * as transparent huge page candidates to reduce TLB misses on very large files.
+ */
+class MappedFile {
+public:
+
+    /**
+     * @brief Maps an existing file read-only.
+     *
+     * @param path Path of the file.
+     * @param huge_pages Hints the kernel to back the mapping with huge pages.
+     */
+    static MappedFile open_read(const string& path, bool huge_pages = false) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0) fail("cannot open " + path);
+        struct stat st;
+        if(fstat(fd, &st) < 0) fail("cannot stat " + path, fd);
+        return MappedFile(fd, (size_t)st.st_size, PROT_READ, huge_pages, path);
+    }
+
+    /**
+     * @brief Creates (or truncates) a file of the given size and maps it read-write.
+     *
+     * @param path Path of the file.
+     * @param size Size of the file in bytes.
+     * @param huge_pages Hints the kernel to back the mapping with huge pages.
+     */
+    static MappedFile create(const string& path, size_t size, bool huge_pages = false) {
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0) fail("cannot create " + path);
+        if(ftruncate(fd, (off_t)size) < 0) fail("cannot resize " + path, fd);
+        return MappedFile(fd, size, PROT_READ | PROT_WRITE, huge_pages, path);
+    }
+
+    /**
+     * @brief Returns true when 'path' is a regular file, i.e. something that can be mapped.
+     */
+    static bool is_regular(const string& path) {
+        struct stat st;
+        return ::stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+    }
+
+    /**
+     * @brief Returns true when 'path' can be the output of encrypt() / decrypt(): it does not exist
+     * yet or is a regular file (a device or a FIFO cannot be resized and mapped).
+     */
+    static bool is_mappable_output(const string& path) {
+        struct stat st;
+        return ::stat(path.c_str(), &st) != 0 || S_ISREG(st.st_mode);
+    }
+
+    /**
+     * @brief Returns true when the open descriptor 'fd' and 'path' are the same file, in which case
+     * creating 'path' as the output would truncate the input (false if 'path' does not exist).
+     */
+    static bool same_file(int fd, const string& path) {
+        struct stat fd_st, path_st;
+        return fstat(fd, &fd_st) == 0 && ::stat(path.c_str(), &path_st) == 0
+               && fd_st.st_dev == path_st.st_dev && fd_st.st_ino == path_st.st_ino;
+    }
+
+    /**
+     * @brief Returns true when both paths name the same existing file.
+     */
+    static bool same_file(const string& path, const string& other) {
+        struct stat st, other_st;
+        return ::stat(path.c_str(), &st) == 0 && ::stat(other.c_str(), &other_st) == 0
+               && st.st_dev == other_st.st_dev && st.st_ino == other_st.st_ino;
+    }
+
+    /**
+     * @brief Encrypts the file 'in_path' into 'out_path' through memory mappings.
+     *
+     * @details Works with any cipher mode exposing encrypt(span<const uint8_t>, span<uint8_t>);
+     * the file size must be a multiple of Cipher::ALIGNMENT unless the mode pads, in which case
+     * only the final padded block goes through a small temporary buffer.
+     *
+     * @return The number of bytes processed.
+     */
+    template<class Cipher>
+    static uint64_t encrypt(Cipher& cipher, const string& in_path, const string& out_path, bool huge_pages = false) {
+        MappedFile input = open_input(in_path, out_path, huge_pages);
+        size_t size = input.size(), whole = size;
+        bool padding = PKCS7::enabled(cipher);
+        if(padding) whole -= size % PKCS7::BLOCK;
+        else check_alignment(size, Cipher::ALIGNMENT);
+
+        OutputFile file(out_path);
+        MappedFile output = map_output(file, padding ? size + PKCS7::pad_length(size) : size, huge_pages, out_path);
+        cipher.encrypt(span<const uint8_t>(input.data(), whole), output.bytes());
+        if(padding){
+            uint8_t tail[2 * PKCS7::BLOCK];
+            memcpy(tail, input.data() + whole, size - whole);
+            size_t tail_size = PKCS7::pad(tail, size - whole);
+            cipher.encrypt(span<const uint8_t>(tail, tail_size), span<uint8_t>(tail, tail_size));
+            memcpy(output.data() + whole, tail, tail_size);
+        }
+        file.commit();
+        return size;
+    }
+
+    /**
+     * @brief Decrypts the file 'in_path' into 'out_path' through memory mappings.
+     *
+     * @details Works with any cipher mode exposing decrypt(span<const uint8_t>, span<uint8_t>);
+     * the file size must be a multiple of Cipher::ALIGNMENT. If the mode pads, the output file is
+     * truncated to remove the padding. If decryption fails (e.g. invalid padding), 'out_path' is
+     * left untouched rather than replaced with the decrypted bytes.
+     *
+     * @return The number of bytes processed.
+     */
+    template<class Cipher>
+    static uint64_t decrypt(Cipher& cipher, const string& in_path, const string& out_path, bool huge_pages = false) {
+        MappedFile input = open_input(in_path, out_path, huge_pages);
+        size_t size = input.size();
+        check_alignment(size, Cipher::ALIGNMENT);
+
+        OutputFile file(out_path);
+        MappedFile output = map_output(file, size, huge_pages, out_path);
+        cipher.decrypt(span<const uint8_t>(input.data(), size), output.bytes());
+        if(PKCS7::enabled(cipher)) output.truncate(PKCS7::unpad(output.data(), size));
+        file.commit();
+        return size;
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) : fd(other.fd), length(other.length), address(other.address) {
+        other.fd = -1;
+        other.length = 0;
+        other.address = nullptr;
+    }
+
+    ~MappedFile() {
+        if(address) munmap(address, length);
+        if(fd >= 0) ::close(fd);
+    }
+
+    /**
+     * @brief Shrinks the underlying file; the mapping itself is left as is and must not be used past 'size'.
+     */
+    void truncate(size_t size) {
+        if(ftruncate(fd, (off_t)size) < 0) fail("cannot resize output");
+    }
+
+    uint8_t* data() const { return (uint8_t*)address; }
+    size_t size() const { return length; }
+    span<uint8_t> bytes() const { return span<uint8_t>(data(), length); }
+
+private:
+
+    int fd;
+    size_t length;
+    void* address;
+
+    MappedFile(int fd_, size_t length_, int protection, bool huge_pages, const string& path)
+        : fd(fd_), length(length_), address(nullptr) {
+        if(length == 0) return; // mmap rejects empty mappings, an empty span is enough
+        address = mmap(nullptr, length, protection, MAP_SHARED, fd, 0);
+        if(address == MAP_FAILED) fail("cannot map " + path, fd);
+        madvise(address, length, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+        if(huge_pages) madvise(address, length, MADV_HUGEPAGE);
+#else
+        (void)huge_pages;
+#endif
+    }
+
+    // Maps the input, refusing to go on if the output is the same file (creating it would truncate the input)
+    static MappedFile open_input(const string& in_path, const string& out_path, bool huge_pages) {
+        MappedFile input = open_read(in_path, huge_pages);
+        if(same_file(input.fd, out_path)) throw runtime_error("input and output must be different files");
+        return input;
+    }
+
+    // Sizes the (not yet committed) output file and maps it read-write through a descriptor of its own
+    static MappedFile map_output(const OutputFile& file, size_t size, bool huge_pages, const string& path) {
+        int fd = ::dup(file.descriptor());
+        if(fd < 0) fail("cannot map " + path);
+        if(ftruncate(fd, (off_t)size) < 0) fail("cannot resize " + path, fd);
+        return MappedFile(fd, size, PROT_READ | PROT_WRITE, huge_pages, path);
+    }
+
+    static void check_alignment(size_t size, size_t alignment) {
+        if(size % alignment != 0)
+            throw runtime_error("input length must be a multiple of " + to_string(alignment) + " bytes");
+    }
+
+    // Throws with the current errno, closing 'fd' first when given
+    [[noreturn]] static void fail(const string& message, int fd = -1) {
+        int error = errno;
+        if(fd >= 0) ::close(fd);
+        throw runtime_error(message + ": " + strerror(error));
+    }
+};
+
+#endif
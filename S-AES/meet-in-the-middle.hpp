@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "fast-saes.hpp"
+#include "bitslice.hpp"
+#include "key-search.hpp"
+#include "multiple-saes.hpp"
+#include "thread-pool.hpp"
+
+using namespace std;
+
+#ifndef MEET_IN_THE_MIDDLE_HPP
+#define MEET_IN_THE_MIDDLE_HPP
+
+/**
+ * @class MeetInTheMiddle
+ * @brief Meet-in-the-middle key recovery for double S-AES from known plaintext.
+ *
+ * @details With C = E_K2(E_K1(P)), the middle value X = E_K1(P) = D_K2(C) can be computed from
+ * both ends independently:
+ * - Forward phase: X is computed for all 2¹⁶ values of K1 and the keys are bucketed by X with a
+ *   counting sort into a compressed table (offsets[X] .. offsets[X + 1] index the K1s giving X):
+ *   two flat arrays, no hashing and no pointer chasing.
+ * - Backward phase: D_K2(C) is computed for all 2¹⁶ values of K2 and looked up in the table.
+ *   About 2¹⁶ (K1, K2) candidates match the first pair. The table also stores E_K1(P1) next to
+ *   each K1, so checking a candidate against the second pair is a comparison with D_K2(C1),
+ *   computed once per K2; only the few survivors are encrypted again for the other pairs.
+ *
+ * The values of both phases come from the multi-key bitsliced kernel (BitslicedSAES::encrypt_many
+ * and decrypt_many), one key per lane.
+ * The attack costs about 2 · 2¹⁶ S-AES operations plus the candidate checks, instead of the 2³²
+ * of an exhaustive search. With a thread pool both phases are split into ranges of keys.
+ * Two pairs usually leave a single key pair; three leave one with near certainty.
+ */
+class MeetInTheMiddle {
+public:
+
+    static const uint32_t KEYS = 1 << 16;
+    static const uint32_t CHUNK_KEYS = 1 << 12; // Keys per parallel task
+
+    /**
+     * @brief Memory footprint and time of each phase of the last attack.
+     */
+    struct Report {
+        size_t table_bytes = 0;     // Forward values, bucket offsets and bucketed keys
+        size_t candidates = 0;      // (K1, K2) matches of the first pair
+        double forward_ms = 0;      // Forward values and table construction
+        double backward_ms = 0;     // Backward values, lookups and checks of the candidates
+    };
+
+    /**
+     * @brief Sets the number of threads used by the attack.
+     *
+     * @param threads Total number of threads (1: serial, 0: one per hardware thread).
+     */
+    void set_threads(int threads) {
+        pool = threads == 1 ? nullptr : make_shared<ThreadPool>(threads);
+    }
+
+    /**
+     * @brief Uses an existing thread pool (possibly shared with the modes of operation).
+     *
+     * @param pool_ The pool, or nullptr for a serial attack.
+     */
+    void set_pool(shared_ptr<ThreadPool> pool_) {
+        pool = pool_;
+    }
+
+    /**
+     * @brief Returns every double S-AES key consistent with all the known pairs.
+     *
+     * @param pairs The known (plaintext, ciphertext) pairs, all under the same key.
+     * @return The consistent 32-bit keys (K1 ‖ K2, see DoubleSAES), in increasing order.
+     * @throws invalid_argument if no pair is given.
+     */
+    vector<uint32_t> attack(span<const KnownPair> pairs) {
+        if(pairs.empty()) throw invalid_argument("meet-in-the-middle needs at least one known pair");
+        report = Report();
+        auto start = chrono::steady_clock::now();
+
+        // Forward phase: middle[k1] = E_k1(P0) (and E_k1(P1)), then keys bucketed by middle value
+        const bool second = pairs.size() > 1;
+        vector<uint16_t> middle(KEYS), middle1(second ? KEYS : 0), keys(KEYS), keys_middle1(middle1.size());
+        vector<uint32_t> offsets(KEYS + 1, 0);
+        for_ranges([&](uint32_t begin, uint32_t end) {
+            uint16_t range[CHUNK_KEYS], blocks[CHUNK_KEYS];
+            fill_range(range, begin, end);
+            fill(blocks, blocks + CHUNK_KEYS, pairs[0].plaintext);
+            BitslicedSAES::encrypt_many(range, blocks, middle.data() + begin, end - begin);
+            if(!second) return;
+            fill(blocks, blocks + CHUNK_KEYS, pairs[1].plaintext);
+            BitslicedSAES::encrypt_many(range, blocks, middle1.data() + begin, end - begin);
+        });
+        for(uint16_t x : middle) offsets[x + 1]++;
+        for(uint32_t x=0; x < KEYS; x++) offsets[x + 1] += offsets[x];
+        {
+            vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+            for(uint32_t k=0; k < KEYS; k++){
+                uint32_t slot = next[middle[k]]++;
+                keys[slot] = (uint16_t)k;
+                if(second) keys_middle1[slot] = middle1[k];
+            }
+        }
+        report.table_bytes = (middle.size() + middle1.size() + keys.size() + keys_middle1.size()) * sizeof(uint16_t)
+                           + offsets.size() * sizeof(uint32_t);
+        auto forward_end = chrono::steady_clock::now();
+
+        // Backward phase: each range of K2 collects its own matches, concatenated in order
+        vector<vector<uint32_t>> found(KEYS / CHUNK_KEYS);
+        vector<size_t> candidates(found.size(), 0);
+        for_ranges([&](uint32_t begin, uint32_t end) {
+            uint16_t range[CHUNK_KEYS], blocks[CHUNK_KEYS], back[CHUNK_KEYS], back1[CHUNK_KEYS];
+            fill_range(range, begin, end);
+            fill(blocks, blocks + CHUNK_KEYS, pairs[0].ciphertext);
+            BitslicedSAES::decrypt_many(range, blocks, back, end - begin);
+            if(second){
+                fill(blocks, blocks + CHUNK_KEYS, pairs[1].ciphertext);
+                BitslicedSAES::decrypt_many(range, blocks, back1, end - begin);
+            }
+
+            uint16_t round_keys2[3], round_keys1[3];
+            for(uint32_t k2=begin; k2 < end; k2++){
+                uint16_t x = back[k2 - begin], x1 = second ? back1[k2 - begin] : 0;
+                candidates[begin / CHUNK_KEYS] += offsets[x + 1] - offsets[x];
+                for(uint32_t i=offsets[x]; i < offsets[x + 1]; i++){
+                    if(second && keys_middle1[i] != x1) continue;
+                    FastSAES::expand_key(keys[i], round_keys1);
+                    FastSAES::expand_key((uint16_t)k2, round_keys2);
+                    bool match = true;
+                    for(size_t p=2; p < pairs.size() && match; p++){
+                        uint16_t block = FastSAES::encrypt(pairs[p].plaintext, round_keys1);
+                        match = FastSAES::encrypt(block, round_keys2) == pairs[p].ciphertext;
+                    }
+                    if(match) found[begin / CHUNK_KEYS].push_back(DoubleSAES::join(keys[i], k2));
+                }
+            }
+        });
+
+        vector<uint32_t> result;
+        for(size_t chunk=0; chunk < found.size(); chunk++){
+            report.candidates += candidates[chunk];
+            result.insert(result.end(), found[chunk].begin(), found[chunk].end());
+        }
+        sort(result.begin(), result.end());
+        auto end = chrono::steady_clock::now();
+        report.forward_ms = chrono::duration<double, milli>(forward_end - start).count();
+        report.backward_ms = chrono::duration<double, milli>(end - forward_end).count();
+        return result;
+    }
+
+    /**
+     * @brief Returns the memory footprint and phase times of the last attack.
+     */
+    const Report& last_report() const {
+        return report;
+    }
+
+private:
+
+    shared_ptr<ThreadPool> pool; // nullptr: serial attack
+    Report report;
+
+    static void fill_range(uint16_t* range, uint32_t begin, uint32_t end) {
+        for(uint32_t k=begin; k < end; k++) range[k - begin] = (uint16_t)k;
+    }
+
+    // Runs fn(begin, end) over ranges of CHUNK_KEYS keys covering the whole key space
+    void for_ranges(const function<void(uint32_t, uint32_t)>& fn) {
+        auto range = [&](size_t begin, size_t end) {
+            for(size_t chunk=begin; chunk < end; chunk++) fn((uint32_t)chunk * CHUNK_KEYS, (uint32_t)(chunk + 1) * CHUNK_KEYS);
+        };
+        if(pool) pool->parallel_for(KEYS / CHUNK_KEYS, 1, range);
+        else range(0, KEYS / CHUNK_KEYS);
+    }
+};
+
+#endif
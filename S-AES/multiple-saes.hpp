@@ -0,0 +1,99 @@
+#include <cstdint>
+
+#include "s-aes.hpp"
+
+using namespace std;
+
+#ifndef MULTIPLE_SAES_HPP
+#define MULTIPLE_SAES_HPP
+
+/**
+ * @class DoubleSAES
+ * @brief Double S-AES: two S-AES encryptions in a row with independent keys.
+ *
+ * @details C = E_K2(E_K1(P)), with a 32-bit key K1 ‖ K2 (K1 in the high half). Although the key
+ * is twice as long, a meet-in-the-middle attack recovers it with about 2 · 2¹⁶ encryptions instead
+ * of 2³² (see MeetInTheMiddle), which is why double encryption is not used in practice.
+ * Both stages are SAES objects without tracing, i.e. the allocation-free fast path.
+ */
+class DoubleSAES {
+public:
+
+    uint32_t key;
+    SAES first, second;
+
+    /**
+     * @brief Constructs a double S-AES cipher.
+     *
+     * @param key_ The 32-bit key: K1 in bits 31-16, K2 in bits 15-0.
+     */
+    DoubleSAES(uint32_t key_) : key(key_), first(key_ >> 16), second(key_ & 0xFFFF) {}
+
+    /**
+     * @brief Constructs a double S-AES cipher from its two 16-bit keys.
+     */
+    DoubleSAES(int key1, int key2) : DoubleSAES(join(key1, key2)) {}
+
+    /**
+     * @brief Packs two 16-bit keys into a 32-bit double S-AES key.
+     */
+    static uint32_t join(int key1, int key2) {
+        return ((uint32_t)(key1 & 0xFFFF) << 16) | (uint32_t)(key2 & 0xFFFF);
+    }
+
+    /**
+     * @brief Encrypts a 16-bit block: E_K2(E_K1(n)).
+     */
+    int encrypt(int n) {
+        return second.encrypt(first.encrypt(n));
+    }
+
+    /**
+     * @brief Decrypts a 16-bit block: D_K1(D_K2(n)).
+     */
+    int decrypt(int n) {
+        return first.decrypt(second.decrypt(n));
+    }
+};
+
+/**
+ * @class TripleSAES
+ * @brief Triple S-AES in encrypt-decrypt-encrypt (EDE) form.
+ *
+ * @details C = E_K3(D_K2(E_K1(P))). With two keys (K3 = K1) the key is 32 bits long, with three
+ * keys 48 bits; a meet-in-the-middle attack on the three-key form still costs about 2³² work,
+ * its effective strength. With K1 = K2 (or K2 = K3) it degenerates to single S-AES, as 3DES
+ * does for backward compatibility.
+ */
+class TripleSAES {
+public:
+
+    SAES first, second, third;
+
+    /**
+     * @brief Constructs a three-key triple S-AES cipher.
+     */
+    TripleSAES(int key1, int key2, int key3)
+        : first(key1), second(key2), third(key3) {}
+
+    /**
+     * @brief Constructs a two-key triple S-AES cipher (K3 = K1).
+     */
+    TripleSAES(int key1, int key2) : TripleSAES(key1, key2, key1) {}
+
+    /**
+     * @brief Encrypts a 16-bit block: E_K3(D_K2(E_K1(n))).
+     */
+    int encrypt(int n) {
+        return third.encrypt(second.decrypt(first.encrypt(n)));
+    }
+
+    /**
+     * @brief Decrypts a 16-bit block: D_K1(E_K2(D_K3(n))).
+     */
+    int decrypt(int n) {
+        return first.decrypt(second.encrypt(third.decrypt(n)));
+    }
+};
+
+#endif
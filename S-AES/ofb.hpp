@@ -0,0 +1,244 @@
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "fast-saes.hpp"
+#include "util.hpp"
+#include "base64.hpp"
+
+using namespace std;
+
+#ifndef OFB_HPP
+#define OFB_HPP
+
+/**
+ * @class OFB
+ * @brief OFB (Output Feedback) mode encryption class for S-AES.
+ *
+ * @details O_0 = IV, O_i = E(O_{i-1}) and C_i = P_i ⊕ O_i. The keystream depends only on the
+ * key and IV, encryption and decryption are the same operation and any length is accepted.
+ *
+ * Generating the keystream is a serial chain of block encryptions, but since E is a permutation
+ * of the 65536 blocks, the sequence O_1, O_2, ... cycles back to the IV after at most 65536 blocks.
+ * With the cache enabled that cycle is computed once per (key, IV), tiled into a buffer of at
+ * least MIN_CACHE_BYTES, and every message becomes a single vectorized XOR pass with random
+ * access (see crypt_at). Rekeying with the same parameters keeps the buffer. Without the cache
+ * the keystream is generated as the data goes, with constant memory.
+ *
+ * encrypt/decrypt(span, span) continue from the current position (as a stream); the string
+ * API always starts at offset 0.
+ */
+class OFB {
+public:
+
+    static const size_t ALIGNMENT = 1;              // Any length, OFB is a stream mode
+    static const size_t MIN_CACHE_BYTES = 1 << 12;  // Short cycles are repeated up to this size
+
+    int key;
+    int iv;
+
+    /**
+     * @brief Constructs an OFB mode encryption object.
+     *
+     * @param key_ The 16-bit key.
+     * @param iv_ The 16-bit initialization vector.
+     * @param cache_ Precomputes and caches the keystream cycle (at most 128 KiB, default: false).
+     */
+    OFB(int key_, int iv_, bool cache_ = false) : key(key_), iv(iv_), use_cache(cache_) {
+        FastSAES::expand_key((uint16_t)key, round_keys);
+        if(use_cache) fill_cache();
+        reset();
+    }
+
+    /**
+     * @brief Replaces the key and IV and restarts from offset 0.
+     *
+     * @details The cached keystream is only recomputed if the parameters actually change.
+     */
+    void rekey(int key_, int iv_) {
+        bool changed = key_ != key || iv_ != iv;
+        key = key_;
+        iv = iv_;
+        FastSAES::expand_key((uint16_t)key, round_keys);
+        if(use_cache && changed) fill_cache();
+        reset();
+    }
+
+    /**
+     * @brief Restarts the stream at offset 0 (start of a new message).
+     */
+    void reset() {
+        position = 0;
+        state = (uint16_t)iv;
+    }
+
+    /**
+     * @brief Enables the keystream cache, computing it now if needed.
+     */
+    void cache() {
+        if(use_cache) return;
+        use_cache = true;
+        fill_cache();
+    }
+
+    /**
+     * @brief Tells whether the keystream cache is enabled.
+     */
+    bool cached() const {
+        return use_cache;
+    }
+
+    /**
+     * @brief Returns the length of the keystream cycle in blocks (0 if the cache is disabled).
+     */
+    size_t period() const {
+        return cycle_blocks;
+    }
+
+    /**
+     * @brief Moves the stream position used by encrypt/decrypt to an arbitrary byte offset.
+     *
+     * @details Constant time with the cache; otherwise the keystream is regenerated up to 'offset'.
+     */
+    void seek(uint64_t offset) {
+        if(!use_cache){
+            if(offset < position) reset();
+            uint8_t skip[256];
+            while(position < offset) next_keystream(skip, (size_t)min<uint64_t>(sizeof(skip), offset - position));
+        }
+        position = offset;
+    }
+
+    /**
+     * @brief Returns the current stream position in bytes.
+     */
+    uint64_t tell() const {
+        return position;
+    }
+
+    /**
+     * @brief Encrypts (XORs with the keystream) 'in' into 'out' starting at byte 'offset' of the message.
+     *
+     * @details Stateless random access, available with the cache only. In-place allowed.
+     *
+     * @throws logic_error if the cache is not enabled.
+     * @throws invalid_argument if the output is smaller than the input.
+     */
+    void crypt_at(span<const uint8_t> in, span<uint8_t> out, uint64_t offset) const {
+        if(!use_cache) throw logic_error("OFB random access needs the keystream cache");
+        check_output(in, out);
+        const uint8_t* src = in.data();
+        uint8_t* dst = out.data();
+        size_t size = in.size(), length = keystream.size();
+        size_t start = (size_t)(offset % length);
+        while(size > 0){
+            size_t run = min(size, length - start);
+            xor_bytes(dst, src, keystream.data() + start, run);
+            src += run;
+            dst += run;
+            size -= run;
+            start = 0;
+        }
+    }
+
+    /**
+     * @brief Encrypts 'in' into 'out' from the current position, then advances it. In-place allowed.
+     *
+     * @throws invalid_argument if the output is smaller than the input.
+     */
+    void encrypt(span<const uint8_t> in, span<uint8_t> out) {
+        Instrument::count_bytes(in.size());
+        Instrument::Timer timer(Instrument::CIPHER);
+        check_output(in, out);
+        if(use_cache){
+            crypt_at(in, out, position);
+            position += in.size();
+            return;
+        }
+        uint8_t buffer[1 << 12];
+        for(size_t done=0; done < in.size(); ){
+            size_t run = min(sizeof(buffer), in.size() - done);
+            next_keystream(buffer, run);
+            xor_bytes(out.data() + done, in.data() + done, buffer, run);
+            done += run;
+        }
+    }
+
+    /**
+     * @brief Decrypts 'in' into 'out' from the current position, then advances it (same as encrypt).
+     */
+    void decrypt(span<const uint8_t> in, span<uint8_t> out) {
+        encrypt(in, out);
+    }
+
+    /**
+     * @brief Encrypts a plaintext string (from offset 0) and returns the ciphertext in Base64.
+     */
+    string encrypt(const string& plainText) {
+        vector<uint8_t> bytes(plainText.begin(), plainText.end());
+        reset();
+        encrypt(bytes, bytes);
+        return Base64::convert_to(bytes);
+    }
+
+    /**
+     * @brief Decrypts a Base64-encoded ciphertext (from offset 0) and returns the plaintext.
+     */
+    string decrypt(const string& cipherText) {
+        string plainText(Base64::decoded_length(cipherText), '\0');
+        span<uint8_t> bytes((uint8_t*)plainText.data(), plainText.size());
+        Base64::decode(cipherText.data(), cipherText.size(), bytes.data());
+        reset();
+        encrypt(bytes, bytes);
+        return plainText;
+    }
+
+private:
+
+    uint16_t round_keys[3];
+    bool use_cache;
+    vector<uint8_t> keystream;  // Whole keystream cycles, at least MIN_CACHE_BYTES
+    size_t cycle_blocks = 0;
+    uint64_t position = 0;
+    uint16_t state;             // Output block containing byte 'position' (uncached generation)
+
+    static void check_output(span<const uint8_t> in, span<uint8_t> out) {
+        if(out.size() < in.size()) throw invalid_argument("output buffer too small");
+    }
+
+    // Follows O_i = E(O_{i-1}) until it returns to the IV, then repeats the cycle
+    void fill_cache() {
+        keystream.clear();
+        uint16_t block = (uint16_t)iv;
+        do {
+            block = FastSAES::encrypt(block, round_keys);
+            keystream.push_back(block >> 8);
+            keystream.push_back(block & 0xFF);
+        } while(block != (uint16_t)iv);
+        cycle_blocks = keystream.size() / 2;
+
+        size_t cycle = keystream.size();
+        keystream.resize((MIN_CACHE_BYTES + cycle - 1) / cycle * cycle);
+        for(size_t i=cycle; i < keystream.size(); i++) keystream[i] = keystream[i - cycle];
+    }
+
+    // Writes the next 'size' keystream bytes and advances the position
+    void next_keystream(uint8_t* buffer, size_t size) {
+        size_t i = 0;
+        if(size > 0 && position % 2 == 1) buffer[i++] = state & 0xFF;
+        for(; i + 2 <= size; i += 2){
+            state = FastSAES::encrypt(state, round_keys);
+            buffer[i] = state >> 8;
+            buffer[i + 1] = state & 0xFF;
+        }
+        if(i < size){
+            state = FastSAES::encrypt(state, round_keys);
+            buffer[i] = state >> 8;
+        }
+        position += size;
+    }
+};
+
+#endif
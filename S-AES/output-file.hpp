@@ -0,0 +1,113 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+#ifndef OUTPUT_FILE_HPP
+#define OUTPUT_FILE_HPP
+
+/**
+ * @class OutputFile
+ * @brief An output file that only replaces its destination once it is complete.
+ *
+ * @details When the destination is a regular file (or does not exist yet), the data is written
+ * to a temporary file in the same directory, which commit() renames over the destination; if
+ * the run fails before commit(), the destructor deletes the temporary file and the destination
+ * is left exactly as it was. A symbolic link is resolved, so the file it points to is replaced
+ * and the link itself is kept. Anything else (a device, a FIFO...) is written in place and never
+ * removed. The destination keeps its permissions (new files get 0644 minus the umask).
+ */
+class OutputFile {
+public:
+
+    /**
+     * @brief Opens the output for writing.
+     *
+     * @throws runtime_error if the temporary file or the destination cannot be opened.
+     */
+    explicit OutputFile(const string& path_) : path(path_), target(path_) {
+        char* real = realpath(path.c_str(), nullptr);
+        if(real){
+            target = real;
+            free(real);
+        }
+        struct stat st;
+        bool exists = ::stat(target.c_str(), &st) == 0;
+        if(exists && !S_ISREG(st.st_mode)){
+            fd = ::open(target.c_str(), O_WRONLY | O_CLOEXEC);
+            if(fd < 0) fail("cannot open " + path);
+            return;
+        }
+
+        size_t slash = target.find_last_of('/');
+        string directory = slash == string::npos ? "." : slash == 0 ? "/" : target.substr(0, slash);
+        string name = slash == string::npos ? target : target.substr(slash + 1);
+        string pattern = directory + "/." + name + ".XXXXXX";
+        vector<char> buffer(pattern.begin(), pattern.end());
+        buffer.push_back('\0');
+        fd = mkstemp(buffer.data());
+        if(fd < 0) fail("cannot create a temporary file next to " + path);
+        temporary = buffer.data();
+
+        mode_t mask = umask(0);
+        umask(mask);
+        if(fchmod(fd, exists ? st.st_mode & 07777 : 0644 & ~mask) < 0) fail("cannot set the permissions of " + path);
+    }
+
+    ~OutputFile() {
+        if(fd >= 0) ::close(fd);
+        if(!temporary.empty()) ::unlink(temporary.c_str());
+    }
+
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+
+    /**
+     * @brief Returns the descriptor to write to (owned by this object).
+     */
+    int descriptor() const {
+        return fd;
+    }
+
+    /**
+     * @brief Closes the file and moves it into place.
+     *
+     * @throws runtime_error if closing or renaming fails (the destination is then left unchanged).
+     */
+    void commit() {
+        int closing = fd;
+        fd = -1;
+        if(::close(closing) < 0) fail("cannot close " + path);
+        if(temporary.empty()) return;
+        if(rename(temporary.c_str(), target.c_str()) < 0) fail("cannot replace " + path);
+        temporary.clear();
+    }
+
+private:
+
+    string path;        // As given, for messages
+    string target;      // With symbolic links resolved
+    string temporary;   // Empty when writing to the destination directly
+    int fd = -1;
+
+    // Throws with the current errno, dropping the temporary file (the destructor does not run in the constructor)
+    [[noreturn]] void fail(const string& message) {
+        int error = errno;
+        if(fd >= 0) ::close(fd);
+        fd = -1;
+        if(!temporary.empty()) ::unlink(temporary.c_str());
+        temporary.clear();
+        throw runtime_error(message + ": " + strerror(error));
+    }
+};
+
+#endif
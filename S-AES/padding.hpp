@@ -0,0 +1,72 @@
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+
+using namespace std;
+
+#ifndef PADDING_HPP
+#define PADDING_HPP
+
+/**
+ * @class PKCS7
+ * @brief PKCS#7-style padding for the 2-byte S-AES block.
+ *
+ * @details Between 1 and BLOCK bytes are always appended, each one equal to the number of bytes
+ * added: an odd-length message gets 01, an even-length one a full block 02 02. Since the last byte
+ * always tells how much to remove, padding is unambiguous even for messages that were already
+ * a multiple of the block size.
+ */
+class PKCS7 {
+public:
+
+    static const size_t BLOCK = 2;
+
+    /**
+     * @brief Returns the number of padding bytes added to a message of 'size' bytes.
+     */
+    static size_t pad_length(size_t size) {
+        return BLOCK - size % BLOCK;
+    }
+
+    /**
+     * @brief Appends the padding to the 'size' bytes of 'buffer'.
+     *
+     * @param buffer The message, with room for pad_length(size) more bytes.
+     * @param size The message length.
+     * @return The padded length, a multiple of BLOCK.
+     */
+    static size_t pad(uint8_t* buffer, size_t size) {
+        size_t length = pad_length(size);
+        for(size_t i=0; i < length; i++) buffer[size + i] = (uint8_t)length;
+        return size + length;
+    }
+
+    /**
+     * @brief Tells whether a cipher mode object pads its messages (modes without a 'padding' member never do).
+     */
+    template<class Cipher>
+    static bool enabled(const Cipher& cipher) {
+        if constexpr (requires { cipher.padding; }) return cipher.padding;
+        else return false;
+    }
+
+    /**
+     * @brief Validates the padding at the end of 'buffer' and returns the unpadded length.
+     *
+     * @param buffer The padded message.
+     * @param size The padded length.
+     * @return The message length without padding.
+     * @throws invalid_argument if the padding is malformed (usually a wrong key or IV).
+     */
+    static size_t unpad(const uint8_t* buffer, size_t size) {
+        if(size == 0 || size % BLOCK != 0) throw invalid_argument("padded length must be a non-zero multiple of the block");
+        size_t length = buffer[size - 1];
+        if(length == 0 || length > BLOCK) throw invalid_argument("invalid padding");
+        for(size_t i=1; i <= length; i++){
+            if(buffer[size - i] != length) throw invalid_argument("invalid padding");
+        }
+        return size - length;
+    }
+};
+
+#endif
@@ -1,8 +1,10 @@
-#include <iostream>
+#include <cstdint>
 #include <vector>
 #include "gf16.hpp"
-#include "base64.hpp"
+#include "fast-saes.hpp"
+#include "trace.hpp"
 #include "util.hpp"
+#include "instrument.hpp"
 
 using namespace std;
 
@@ -16,25 +18,44 @@ using namespace std;
  * @details S-AES operates on 16-bit plaintext and ciphertext blocks using a 16-bit key.
  * The algorithm includes SubNibbles (S-box substitution), ShiftRows (permutation), 
  * MixColumns (matrix multiplication in GF(2⁴)), AddRoundKey (XOR with round key), 
- * and key expansion with round constants. The class supports optional debugging output
- * and integrates with ECB mode through an external wrapper.
+ * and key expansion with round constants. The class supports optional tracing of the
+ * intermediate states and integrates with ECB mode through an external wrapper.
+ *
+ * Blocks go through the allocation-free FastSAES path using the round keys cached by the
+ * constructor / rekey. The round-by-round nibble matrix implementation is kept as the reference
+ * (encrypt_reference / decrypt_reference): it derives its own round keys, as in the specification,
+ * and is used for the blocks a trace sink samples, recording each step as a binary snapshot
+ * (see TraceSink).
  */
 class SAES {
 public:
 
     int key;
-    bool debug;
-    bool ecb;
+    TraceSink* trace;       // nullptr: no tracing
+    uint16_t round_keys[3]; // Key0, Key1, Key2 packed as 16-bit words (see rekey)
     
     /**
-     * @brief Constructs an instance of the S-AES cipher with the specified key and flags.
+     * @brief Constructs an instance of the S-AES cipher with the specified key.
      * 
      * @param key_ The 16-bit encryption key.
-     * @param debug_ Optional flag to enable debugging output (default: false).
-     * @param ecb_ Optional flag to indicate ECB mode usage (default: false).
+     * @param trace_ Optional sink receiving the intermediate states (default: none). It is not
+     * owned and must outlive the cipher, or be reset before it is destroyed.
      */
-    SAES(int key_, bool debug_ = false, bool ecb_ = false) : key(key_), debug(debug_), ecb(ecb_) { 
+    SAES(int key_, TraceSink* trace_ = nullptr) : trace(trace_) { 
+        rekey(key_);
+    }
 
+    /**
+     * @brief Replaces the cipher key and recomputes the cached round-key schedule.
+     * 
+     * @details The three round keys are expanded once here and reused by every block,
+     * so the fast path never runs the key expansion. No heap allocation is performed.
+     * 
+     * @param key_ The new 16-bit encryption key.
+     */
+    void rekey(int key_) {
+        key = key_;
+        FastSAES::expand_key((uint16_t)key, round_keys);
     }
 
     /**
@@ -45,57 +66,49 @@ public:
      * - Round 1: SubNibbles, ShiftRows, MixColumns, AddRoundKey
      * - Round 2: SubNibbles, ShiftRows, AddRoundKey
      * 
-     * Intermediate results may be displayed if debugging is enabled.
+     * Blocks sampled by the trace sink go through the reference implementation.
      * 
      * @param n The 16-bit plaintext block to encrypt.
      * @return The 16-bit ciphertext block resulting from encryption.
      */
     int encrypt(int n) {
-        if(!ecb){
-            cout << "\n====================== S-AES - Encryption ======================\n\n";
-            cout << "Plaintext:         " << toBin(n, 16) << endl;
-            cout << "Initial key:       " << toBin(key, 16) << "\n\n";
-        }   
+        Instrument::count_bytes(2);
+        if(trace && trace->sample()) return encrypt_reference(n);
+        return FastSAES::encrypt((uint16_t)n, round_keys);
+    }
 
+    /**
+     * @brief Encrypts a 16-bit block with the round-by-round reference implementation.
+     *
+     * @details Same result as encrypt, but the state is kept as a 2×2 nibble matrix and every step
+     * is computed explicitly, recorded by the trace sink when one is set.
+     *
+     * @param n The 16-bit plaintext block to encrypt.
+     * @return The 16-bit ciphertext block resulting from encryption.
+     */
+    int encrypt_reference(int n) {
         vector<vector<int>> nibbles = split_to_nibbles(n);
         vector<vector<int>> key_nibbles = split_to_nibbles(this->key);
+        record(TraceStep::BEGIN, 0, n, key, false);
 
-        if(debug) cout << "------------- Round 0 --------------\n\n";
-        add_round_key(nibbles, key_nibbles);
+        record(TraceStep::ROUND, 0, n, 0, false);
+        add_round_key(nibbles, key_nibbles, 0);
 
-        if(debug) cout << "------------- Round 1 --------------\n\n";
-        sub_nibbles(nibbles);
-        shift_rows(nibbles);
-        mix_columns(nibbles);
+        record(TraceStep::ROUND, 1, join_nibbles(nibbles), 0, false);
+        sub_nibbles(nibbles, 1);
+        shift_rows(nibbles, 1);
+        mix_columns(nibbles, 1);
         expand_key(key_nibbles, 1);
-        add_round_key(nibbles, key_nibbles);
+        add_round_key(nibbles, key_nibbles, 1);
 
-        if(debug) cout << "------------- Final Round (2) --------------\n\n";
-        sub_nibbles(nibbles);
-        shift_rows(nibbles);
+        record(TraceStep::ROUND, 2, join_nibbles(nibbles), 0, false);
+        sub_nibbles(nibbles, 2);
+        shift_rows(nibbles, 2);
         expand_key(key_nibbles, 2);
-        add_round_key(nibbles, key_nibbles);
-
-        // Converts the nibbles into a 16-bit integer (ciphertext)
-        int ciphertext=0;
-        for(int i=0; i < 2; i++){
-            for(int j=0; j < 2; j++){
-                ciphertext <<= 4;
-                ciphertext |= nibbles[j][i];
-            }
-        }
-
-        if(!ecb){
-            cout << "-------------------------------------------------------------\n\n";
-            cout << "-> Ciphertext\n\n";
-            cout << "Bin:               ";
-            print(nibbles);
-            printf("\nHex:               %X\n", ciphertext);
-            auto bytes = fromBinToVectorByte(toBin(nibbles));
-            cout << "Base64:            " << Base64::convert_to(bytes);
-            cout << "\n=============================================================\n\n";
-        }
+        add_round_key(nibbles, key_nibbles, 2);
 
+        int ciphertext = join_nibbles(nibbles);
+        record(TraceStep::END, 2, ciphertext, 0, false);
         return ciphertext;
     }
 
@@ -107,71 +120,53 @@ public:
      * - Round 1: AddRoundKey, InverseMixColumns, InverseShiftRows, InverseSubNibbles
      * - Round 0: AddRoundKey
      * 
-     * Round keys are expanded before decryption. Intermediate results may be shown if debugging is enabled.
+     * Blocks sampled by the trace sink go through the reference implementation.
      * 
      * @param n The 16-bit ciphertext block to decrypt.
      * @return The 16-bit plaintext block resulting from decryption.
      */
     int decrypt(int n){
-        if(!ecb){
-            cout << "\n====================== S-AES - Decryption ======================\n\n";
-            cout << "Ciphertext:        " << toBin(n, 16) << endl;
-            cout << "Initial key:       " << toBin(key, 16) << "\n\n";
-        }
+        Instrument::count_bytes(2);
+        if(trace && trace->sample()) return decrypt_reference(n);
+        return FastSAES::decrypt((uint16_t)n, round_keys);
+    }
 
+    /**
+     * @brief Decrypts a 16-bit block with the round-by-round reference implementation.
+     *
+     * @details Same result as decrypt, but the state is kept as a 2×2 nibble matrix and every step
+     * is computed explicitly, recorded by the trace sink when one is set.
+     *
+     * @param n The 16-bit ciphertext block to decrypt.
+     * @return The 16-bit plaintext block resulting from decryption.
+     */
+    int decrypt_reference(int n){
         vector<vector<int>> nibbles = split_to_nibbles(n);
+        record(TraceStep::BEGIN, 2, n, key, true);
 
-        if(debug)
-            cout << "------------- Key Generation --------------\n\n";
+        record(TraceStep::KEY_SCHEDULE, 0, n, 0, true);
         vector<vector<int>> key0_nibbles = split_to_nibbles(this->key);
         vector<vector<int>> key1_nibbles = key0_nibbles;
-        expand_key(key1_nibbles, 1);
+        expand_key(key1_nibbles, 1, true);
         vector<vector<int>> key2_nibbles = key1_nibbles;
-        expand_key(key2_nibbles, 2);
-        if(debug){
-            cout << "Key0 = ";
-            print(key0_nibbles);
-            cout << "\nKey1 = ";
-            print(key1_nibbles);
-            cout << "\nKey2 = ";
-            print(key2_nibbles);
-            cout << "\n\n";
-        }
+        expand_key(key2_nibbles, 2, true);
 
-        if(debug) cout << "------------- Initial Round (2) --------------\n\n";
-        add_round_key(nibbles, key2_nibbles);
-        shift_rows(nibbles);
-        sub_nibbles(nibbles, true);
+        record(TraceStep::ROUND, 2, n, 0, true);
+        add_round_key(nibbles, key2_nibbles, 2, true);
+        shift_rows(nibbles, 2, true);
+        sub_nibbles(nibbles, 2, true);
 
-        if(debug) cout << "------------- Round 1 --------------\n\n";
-        add_round_key(nibbles, key1_nibbles);
-        mix_columns(nibbles, true);
-        shift_rows(nibbles);
-        sub_nibbles(nibbles, true);
+        record(TraceStep::ROUND, 1, join_nibbles(nibbles), 0, true);
+        add_round_key(nibbles, key1_nibbles, 1, true);
+        mix_columns(nibbles, 1, true);
+        shift_rows(nibbles, 1, true);
+        sub_nibbles(nibbles, 1, true);
 
-        if(debug) cout << "------------- Final Round (0) --------------\n\n";
-        add_round_key(nibbles, key0_nibbles);
-
-        // Converts the nibbles into a 16-bit integer (plaintext)
-        int plaintext=0;
-        for(int i=0; i < 2; i++){
-            for(int j=0; j < 2; j++){
-                plaintext <<= 4;
-                plaintext |= nibbles[j][i];
-            }
-        }
-        
-        if(!ecb){
-            cout << "-------------------------------------------------------------\n\n";
-            cout << "-> Plaintext\n\n";
-            cout << "Bin:               ";
-            print(nibbles);
-            printf("\nHex:               %X\n", plaintext);
-            auto bytes = fromBinToVectorByte(toBin(nibbles));
-            cout << "Base64:            " << Base64::convert_to(bytes);
-            cout << "\n=============================================================\n\n";
-        }
+        record(TraceStep::ROUND, 0, join_nibbles(nibbles), 0, true);
+        add_round_key(nibbles, key0_nibbles, 0, true);
 
+        int plaintext = join_nibbles(nibbles);
+        record(TraceStep::END, 0, plaintext, 0, true);
         return plaintext;
     }
 
@@ -189,6 +184,7 @@ private:
             nibbles[1][1] ← least significant nibble (bits 3-0) 
     */
     vector<vector<int>> split_to_nibbles(int n){
+        Instrument::count(Instrument::ALLOCATIONS, 3);
         vector<vector<int>> nibbles(2, vector<int>(2));
         // Extract 4-bit chunks from least to most significant
         for(int i=1; i >= 0; i--){
@@ -199,85 +195,93 @@ private:
         }
         return nibbles;
     }
-    
-    // XORs each nibble in the state matrix with the corresponding nibble in the round key
-    void add_round_key(vector<vector<int>>& nibbles, vector<vector<int>>& key_vector){
-        if(debug){ 
-            cout << "Adding round key:\n= ";
-            print(nibbles);
-            cout << "  XOR  ";
-            print(key_vector);
-        }
+
+    // Converts the nibbles back into a 16-bit integer (inverse of split_to_nibbles)
+    static int join_nibbles(const vector<vector<int>>& nibbles){
+        int n=0;
         for(int i=0; i < 2; i++){
             for(int j=0; j < 2; j++){
-                nibbles[i][j] ^= key_vector[i][j];
+                n <<= 4;
+                n |= nibbles[j][i];
             }
         }
-        if(debug){
-            cout << "\n= ";
-            print(nibbles);
-            cout << "\n\n";
+        return n;
+    }
+
+    // Passes one snapshot of the state to the trace sink, if any
+    void record(TraceStep step, int round, int state, int operand, bool decrypt){
+        if(!trace) return;
+        TraceEvent event;
+        event.state = (uint16_t)state;
+        event.operand = (uint16_t)operand;
+        event.step = step;
+        event.round = (uint8_t)round;
+        event.decrypt = decrypt;
+        trace->record(event);
+    }
+    
+    // XORs each nibble in the state matrix with the corresponding nibble in the round key
+    void add_round_key(vector<vector<int>>& nibbles, vector<vector<int>>& key_vector, int round, bool decrypt = false){
+        {
+            Instrument::Timer timer(Instrument::ADD_ROUND_KEY);
+            for(int i=0; i < 2; i++){
+                for(int j=0; j < 2; j++){
+                    nibbles[i][j] ^= key_vector[i][j];
+                }
+            }
         }
+        if(trace) record(TraceStep::ADD_ROUND_KEY, round, join_nibbles(nibbles), join_nibbles(key_vector), decrypt);
     }
     
     // Applies the S-box substitution on a 4-bit nibble
     int apply_sbox(int nibble, bool decrypt = false){
         // Row 0: encryption S-box | Row 1: decryption S-box
-        vector<vector<int>> sbox_nibble = {
-            {9, 4, 10, 11, 13, 1, 8, 5, 6, 2, 0, 3, 12, 14, 15, 7},
-            {10, 5, 9, 11, 1, 7, 8, 15, 6, 0, 2, 3, 12, 4, 13, 14}
-        };
-        return sbox_nibble[decrypt][nibble];
+        return FastSAES::SBOX[decrypt][nibble];
     }
     
     // Applies the S-box transformation to each nibble in the 2×2 state matrix
     // Uses encryption S-box by default; decryption if 'decrypt' is true
-    void sub_nibbles(vector<vector<int>>& nibbles, bool decrypt = false){
-        for(int i=0; i < 2; i++){
-            for(int j=0; j < 2; j++){
-                nibbles[i][j] = apply_sbox(nibbles[i][j], decrypt);
+    void sub_nibbles(vector<vector<int>>& nibbles, int round, bool decrypt = false){
+        {
+            Instrument::Timer timer(Instrument::SUB_NIBBLES);
+            for(int i=0; i < 2; i++){
+                for(int j=0; j < 2; j++){
+                    nibbles[i][j] = apply_sbox(nibbles[i][j], decrypt);
+                }
             }
         }
-        if(debug){
-            cout << "Substituting nibbles:\n= ";
-            print(nibbles);
-            cout << "\n\n";
-        }
+        if(trace) record(TraceStep::SUB_NIBBLES, round, join_nibbles(nibbles), 0, decrypt);
     }
     
     // Shift the second row (swapping the first and second nibble)
-    void shift_rows(vector<vector<int>>& nibbles){
-        swap(nibbles[1][0], nibbles[1][1]);
-        if(debug){
-            cout << "Shifting rows:\n= ";
-            print(nibbles);
-            cout << "\n\n";
+    void shift_rows(vector<vector<int>>& nibbles, int round, bool decrypt = false){
+        {
+            Instrument::Timer timer(Instrument::SHIFT_ROWS);
+            swap(nibbles[1][0], nibbles[1][1]);
         }
+        if(trace) record(TraceStep::SHIFT_ROWS, round, join_nibbles(nibbles), 0, decrypt);
     }
 
     /*  Performs the MixColumns step on the 2×2 state matrix
         Multiplies the matrix by a fixed basis matrix in GF(2⁴)
         Uses different matrices for encryption and decryption 
     */
-    void mix_columns(vector<vector<int>>& matrix, bool decrypt = false){
-        vector<vector<int>> ans(2, vector<int>(2, 0));
-        vector<vector<vector<int>>> mult={
-            {{1, 4}, {4, 1}},  // encription matrix
-            {{9, 2}, {2, 9}}   // decription matrix
-        };
-        for(int i=0; i < 2; i++){
-            for(int j=0; j < 2; j++){
-                for(int k=0; k < 2; k++){
-                    ans[i][j] ^= GF.mul(mult[decrypt][i][k], matrix[k][j]);
+    void mix_columns(vector<vector<int>>& matrix, int round, bool decrypt = false){
+        {
+            Instrument::Timer timer(Instrument::MIX_COLUMNS);
+            Instrument::count(Instrument::ALLOCATIONS, 3);
+            vector<vector<int>> ans(2, vector<int>(2, 0));
+            // FastSAES::MIX[0] is the encryption matrix, FastSAES::MIX[1] the decryption one
+            for(int i=0; i < 2; i++){
+                for(int j=0; j < 2; j++){
+                    for(int k=0; k < 2; k++){
+                        ans[i][j] ^= GF.mul(FastSAES::MIX[decrypt][i][k], matrix[k][j]);
+                    }
                 }
             }
+            swap(ans, matrix);
         }
-        swap(ans, matrix);
-        if(debug){
-            cout << "Mixing Columns:\n= ";
-            print(matrix);
-            cout << "\n\n";
-        }
+        if(trace) record(TraceStep::MIX_COLUMNS, round, join_nibbles(matrix), 0, decrypt);
     }
 
     /*  Applies the g-function from the S-AES key expansion:
@@ -291,32 +295,27 @@ private:
 
     /*
         Expands the round key using the g-function and a round constant.
-        'round' is the current round number (0-based).
+        'round' is the number of the round key produced (1 or 2).
     */
-    void expand_key(vector<vector<int>>& key_vector, int round){
-        if(debug){
-            cout << "Expanding Key " << round-1 << " (";
-            print(key_vector);
-            cout << "):\nKey " << round << " = ";
-        }
-        
-        vector<int> key1 = { key_vector[0][1], key_vector[1][1] };
-        g_function(key1);
-
-        // Add round constant: 2^(round+2) reduced mod the primitive polynomial.
-        key1[0] ^= GF.mod(1 << (round+2));
-
-        // First new column = previous column XOR g_function result
-        for(int i=0; i < 2; i++) key_vector[i][0] ^= key1[i];
-
-        // Second new column = first new column XOR previous column
-        for(int i=0; i < 2; i++) key_vector[i][1] ^= key_vector[i][0];
-
-        if(debug){
-            print(key_vector);
-            cout << "\n\n";
+    void expand_key(vector<vector<int>>& key_vector, int round, bool decrypt = false){
+        int previous = trace ? join_nibbles(key_vector) : 0;
+        {
+            Instrument::Timer timer(Instrument::EXPAND_KEY);
+            Instrument::count(Instrument::ALLOCATIONS);
+            vector<int> key1 = { key_vector[0][1], key_vector[1][1] };
+            g_function(key1);
+
+            // Add round constant: 2^(round+2) reduced mod the primitive polynomial.
+            key1[0] ^= GF.mod(1 << (round+2));
+
+            // First new column = previous column XOR g_function result
+            for(int i=0; i < 2; i++) key_vector[i][0] ^= key1[i];
+
+            // Second new column = first new column XOR previous column
+            for(int i=0; i < 2; i++) key_vector[i][1] ^= key_vector[i][0];
         }
+        if(trace) record(TraceStep::EXPAND_KEY, round, join_nibbles(key_vector), previous, decrypt);
     }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,208 @@
+#include <cstdint>
+#include <cstddef>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "padding.hpp"
+#include "format.hpp"
+#include "util.hpp"
+#include "instrument.hpp"
+
+using namespace std;
+
+#ifndef STREAM_HPP
+#define STREAM_HPP
+
+/**
+ * @class Stream
+ * @brief Chunked processing of arbitrarily large inputs with bounded memory.
+ *
+ * @details Data is read from a std::istream or a POSIX file descriptor in fixed-size chunks,
+ * transformed in place and written out before the next chunk is read, so the memory held is
+ * constant (at most two chunks) regardless of the input size. The chunk size is rounded down
+ * to a multiple of the 2-byte S-AES block, so every chunk except the last one holds whole blocks.
+ * The cipher modes declare in ALIGNMENT the granularity their input length must respect
+ * (2 bytes for block modes such as ECB, 1 byte for stream modes such as CTR). Modes with padding
+ * enabled have their last chunk padded on encryption and unpadded on decryption.
+ * With a FormatReader / FormatWriter pair, hex or Base64 text is decoded straight into the chunk
+ * buffer and the result encoded on the way out, so text files need no separate conversion pass.
+ */
+class Stream {
+public:
+
+    static const size_t CHUNK_SIZE = 1 << 20; // 1 MiB
+    static const size_t SLACK = PKCS7::BLOCK; // Extra room after each chunk, for padding
+
+    /*  Transforms 'size' bytes of 'buffer' in place. 'last' is true for the final chunk of the input.
+        Returns the number of bytes of 'buffer' to write out (at most size + SLACK).
+    */
+    typedef function<size_t(uint8_t* buffer, size_t size, bool last)> Transform;
+
+    /**
+     * @brief Streams 'in' through 'transform' into 'out'.
+     *
+     * @param in Input stream (opened in binary mode for files).
+     * @param out Output stream.
+     * @param transform The chunk transformation.
+     * @param chunk_size Bytes read per chunk (default: 1 MiB).
+     * @return The number of input bytes processed.
+     */
+    static uint64_t run(istream& in, ostream& out, const Transform& transform, size_t chunk_size = CHUNK_SIZE) {
+        chunk_size = block_aligned(chunk_size);
+        vector<uint8_t> buffer(chunk_size + SLACK);
+        Instrument::count(Instrument::ALLOCATIONS);
+        uint64_t total = 0;
+
+        while(true){
+            {
+                Instrument::Timer timer(Instrument::IO_READ);
+                in.read((char*)buffer.data(), chunk_size);
+            }
+            size_t size = (size_t)in.gcount();
+            if(in.bad()) throw runtime_error("error reading input stream");
+            bool last = size < chunk_size || in.peek() == char_traits<char>::eof();
+            total += size;
+
+            size_t written = transform(buffer.data(), size, last);
+            {
+                Instrument::Timer timer(Instrument::IO_WRITE);
+                out.write((const char*)buffer.data(), written);
+            }
+            if(!out) throw runtime_error("error writing output stream");
+            if(last) break;
+        }
+        return total;
+    }
+
+    /**
+     * @brief Streams the file descriptor 'in_fd' through 'transform' into 'out_fd'.
+     *
+     * @details The next chunk is read ahead before the current one is transformed, which is how
+     * the end of the input is detected without a peek; the memory used is two chunks.
+     *
+     * @param in_fd Readable file descriptor (file, pipe or socket).
+     * @param out_fd Writable file descriptor.
+     * @param transform The chunk transformation.
+     * @param chunk_size Bytes read per chunk (default: 1 MiB).
+     * @return The number of input bytes processed.
+     */
+    static uint64_t run(int in_fd, int out_fd, const Transform& transform, size_t chunk_size = CHUNK_SIZE) {
+        return run_ahead([&](uint8_t* buffer, size_t size) { return ::read_full(in_fd, buffer, size); },
+                         [&](const uint8_t* buffer, size_t size) { ::write_full(out_fd, buffer, size); },
+                         transform, block_aligned(chunk_size));
+    }
+
+    /**
+     * @brief Streams decoded data from 'in' through 'transform' and encodes the result into 'out'.
+     *
+     * @details The chunk size is rounded to a multiple of both the 2-byte block and the reader's
+     * granularity (6 bytes for Base64 input). Reads ahead like the file descriptor version.
+     *
+     * @param in Reader decoding raw, hex or Base64 input.
+     * @param out Writer encoding the output; finished once the input is exhausted.
+     * @param transform The chunk transformation.
+     * @param chunk_size Decoded bytes per chunk (default: 1 MiB).
+     * @return The number of decoded input bytes processed.
+     */
+    static uint64_t run(FormatReader& in, FormatWriter& out, const Transform& transform, size_t chunk_size = CHUNK_SIZE) {
+        size_t step = 2 * in.granularity();
+        chunk_size = max(step, chunk_size / step * step);
+        uint64_t total = run_ahead([&](uint8_t* buffer, size_t size) { return read_full(in, buffer, size); },
+                                   [&](const uint8_t* buffer, size_t size) { out.write(buffer, size); },
+                                   transform, chunk_size);
+        out.finish();
+        return total;
+    }
+
+    /**
+     * @brief Encrypts a stream with any cipher mode exposing encrypt(span<const uint8_t>, span<uint8_t>).
+     *
+     * @details The input length must be a multiple of Cipher::ALIGNMENT. Stateful modes keep
+     * their position between chunks, so the result is the same as for a single call.
+     *
+     * @return The number of bytes processed.
+     */
+    template<class Cipher, class In, class Out>
+    static uint64_t encrypt(Cipher& cipher, In&& in, Out&& out, size_t chunk_size = CHUNK_SIZE) {
+        return run(in, out, [&](uint8_t* buffer, size_t size, bool last) {
+            if(last && PKCS7::enabled(cipher)) size = PKCS7::pad(buffer, size);
+            check_alignment(size, Cipher::ALIGNMENT);
+            cipher.encrypt(span<const uint8_t>(buffer, size), span<uint8_t>(buffer, size));
+            return size;
+        }, chunk_size);
+    }
+
+    /**
+     * @brief Decrypts a stream with any cipher mode exposing decrypt(span<const uint8_t>, span<uint8_t>).
+     *
+     * @details The input length must be a multiple of Cipher::ALIGNMENT. Stateful modes keep
+     * their position between chunks, so the result is the same as for a single call.
+     *
+     * @return The number of bytes processed.
+     */
+    template<class Cipher, class In, class Out>
+    static uint64_t decrypt(Cipher& cipher, In&& in, Out&& out, size_t chunk_size = CHUNK_SIZE) {
+        return run(in, out, [&](uint8_t* buffer, size_t size, bool last) {
+            check_alignment(size, Cipher::ALIGNMENT);
+            cipher.decrypt(span<const uint8_t>(buffer, size), span<uint8_t>(buffer, size));
+            if(last && PKCS7::enabled(cipher)) size = PKCS7::unpad(buffer, size);
+            return size;
+        }, chunk_size);
+    }
+
+private:
+
+    // Reads one chunk ahead of the one being transformed to tell whether the current one is the last
+    template<class Read, class Write>
+    static uint64_t run_ahead(Read read, Write write, const Transform& transform, size_t chunk_size) {
+        vector<uint8_t> current(chunk_size + SLACK), next(chunk_size + SLACK);
+        Instrument::count(Instrument::ALLOCATIONS, 2);
+        uint64_t total = 0;
+
+        size_t size = read(current.data(), chunk_size);
+        while(true){
+            size_t next_size = size == chunk_size ? read(next.data(), chunk_size) : 0;
+            bool last = next_size == 0;
+            total += size;
+
+            size_t written = transform(current.data(), size, last);
+            write(current.data(), written);
+            if(last) break;
+
+            swap(current, next);
+            size = next_size;
+        }
+        return total;
+    }
+
+    static size_t block_aligned(size_t chunk_size) {
+        return chunk_size < 2 ? 2 : chunk_size & ~(size_t)1;
+    }
+
+    static void check_alignment(size_t size, size_t alignment) {
+        if(size % alignment != 0)
+            throw runtime_error("input length must be a multiple of " + to_string(alignment) + " bytes");
+    }
+
+    // Decodes until 'size' bytes are available or the end of the input is reached
+    static size_t read_full(FormatReader& in, uint8_t* buffer, size_t size) {
+        size_t done = 0;
+        while(done < size){
+            size_t r = in.read(buffer + done, size - done);
+            if(r == 0) break;
+            done += r;
+        }
+        return done;
+    }
+};
+
+#endif
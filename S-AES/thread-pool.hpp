@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+/**
+ * @class ThreadPool
+ * @brief Fixed set of worker threads running data-parallel loops.
+ *
+ * @details parallel_for splits an index range into grains that the workers (and the calling
+ * thread) claim one after another from a shared atomic counter. Threads that finish their grains
+ * early simply claim more, so the load balances itself like work stealing, without per-thread
+ * queues. Each grain is a disjoint range, which lets callers write results straight into
+ * disjoint regions of an output buffer with no merging step.
+ */
+class ThreadPool {
+public:
+
+    /**
+     * @brief Starts a pool using 'threads_' threads in total (the caller counts as one).
+     *
+     * @param threads_ Total number of threads; 0 means one per hardware thread.
+     */
+    ThreadPool(int threads_ = 0) {
+        threads = threads_ > 0 ? threads_ : max(1, (int)thread::hardware_concurrency());
+        for(int i=1; i < threads; i++) workers.emplace_back([this] { work(); });
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(state_mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(auto &worker : workers) worker.join();
+    }
+
+    /**
+     * @brief Returns the total number of threads used by parallel_for.
+     */
+    int size() const {
+        return threads;
+    }
+
+    /**
+     * @brief Calls fn(begin, end) over disjoint ranges covering [0, count), in parallel.
+     *
+     * @details Returns once every range has been processed. The first exception thrown by 'fn'
+     * is rethrown in the calling thread. Concurrent calls are serialized.
+     *
+     * @param count Size of the index range.
+     * @param grain Size of the ranges handed to the threads.
+     * @param fn The function to run on each range.
+     */
+    void parallel_for(size_t count, size_t grain, const function<void(size_t, size_t)>& fn) {
+        if(count == 0) return;
+        grain = max<size_t>(grain, 1);
+        if(workers.empty() || count <= grain){
+            fn(0, count);
+            return;
+        }
+
+        lock_guard<mutex> serial(run_mutex);
+        {
+            lock_guard<mutex> lock(state_mutex);
+            job = &fn;
+            job_count = count;
+            job_grain = grain;
+            next = 0;
+            error = nullptr;
+            pending = (int)workers.size();
+            generation++;
+        }
+        wake.notify_all();
+
+        drain();
+
+        unique_lock<mutex> lock(state_mutex);
+        finished.wait(lock, [this] { return pending == 0; });
+        job = nullptr;
+        if(error) rethrow_exception(error);
+    }
+
+private:
+
+    int threads;
+    vector<thread> workers;
+
+    mutex run_mutex;              // Serializes parallel_for calls
+    mutex state_mutex;            // Protects the job description below
+    condition_variable wake, finished;
+    bool stopping = false;
+    size_t generation = 0;        // Incremented for every new job
+    int pending = 0;              // Workers that have not finished the current job
+
+    const function<void(size_t, size_t)>* job = nullptr;
+    size_t job_count = 0, job_grain = 0;
+    atomic<size_t> next{0};
+    exception_ptr error;
+
+    void work() {
+        size_t seen = 0;
+        while(true){
+            {
+                unique_lock<mutex> lock(state_mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if(stopping) return;
+                seen = generation;
+            }
+            drain();
+            lock_guard<mutex> lock(state_mutex);
+            if(--pending == 0) finished.notify_one();
+        }
+    }
+
+    // Claims and runs grains of the current job until none is left
+    void drain() {
+        while(true){
+            size_t begin = next.fetch_add(job_grain);
+            if(begin >= job_count) return;
+            try {
+                (*job)(begin, min(job_count, begin + job_grain));
+            } catch(...) {
+                lock_guard<mutex> lock(state_mutex);
+                if(!error) error = current_exception();
+                next = job_count;
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <iostream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "util.hpp"
+
+using namespace std;
+
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+/**
+ * @brief The step of the reference S-AES path a trace event describes.
+ */
+enum class TraceStep : uint8_t {
+    BEGIN,          // state: the input block, operand: the key
+    KEY_SCHEDULE,   // start of the round-key generation (decryption)
+    ROUND,          // start of a round
+    ADD_ROUND_KEY,  // state after the XOR, operand: the round key
+    SUB_NIBBLES,
+    SHIFT_ROWS,
+    MIX_COLUMNS,
+    EXPAND_KEY,     // state: the new round key, operand: the previous one
+    END             // state: the output block
+};
+
+/**
+ * @brief One binary snapshot of the 16-bit state, as recorded on the hot path.
+ */
+struct TraceEvent {
+    uint64_t block = 0;     // Index of the block among those the sink was offered (set by the sink)
+    uint16_t state = 0;
+    uint16_t operand = 0;
+    TraceStep step = TraceStep::BEGIN;
+    uint8_t round = 0;
+    bool decrypt = false;
+};
+
+/**
+ * @class TraceSink
+ * @brief Receives the intermediate states of the blocks traced by SAES.
+ *
+ * @details Before each block, the cipher asks sample() whether the block is traced; the blocks
+ * that are not go through the fast path and cost one virtual call. The events of a traced block
+ * are plain 16-byte records: formatting them is left to the sink, possibly long after the run.
+ * Sinks are not thread-safe; each thread tracing concurrently needs its own.
+ */
+class TraceSink {
+public:
+
+    virtual ~TraceSink() = default;
+
+    /**
+     * @brief Called once before each block; returns whether the steps of that block are recorded.
+     */
+    virtual bool sample() = 0;
+
+    /**
+     * @brief Records one step of the block last sampled.
+     */
+    virtual void record(const TraceEvent& event) = 0;
+};
+
+/**
+ * @class NullTraceSink
+ * @brief Traces nothing: every block takes the fast path.
+ */
+class NullTraceSink : public TraceSink {
+public:
+
+    bool sample() override { return false; }
+    void record(const TraceEvent&) override {}
+};
+
+/**
+ * @class RingTraceSink
+ * @brief Keeps the last events of one block out of every 'period' in a fixed-size ring buffer.
+ *
+ * @details The buffer is allocated once; when it is full the oldest events are overwritten, so
+ * tracing runs indefinitely in constant memory. events() returns the snapshots in order, to be
+ * formatted by TextTraceSink::format() or processed as binary records.
+ */
+class RingTraceSink : public TraceSink {
+public:
+
+    /**
+     * @brief Constructs a ring buffer sink.
+     *
+     * @param capacity Number of events kept (at least 1).
+     * @param period_ Traces one block out of every 'period_' (1: all of them).
+     */
+    RingTraceSink(size_t capacity, uint64_t period_ = 1) : buffer(max<size_t>(capacity, 1)), period(max<uint64_t>(period_, 1)) {}
+
+    bool sample() override {
+        block = blocks++;
+        return block % period == 0;
+    }
+
+    void record(const TraceEvent& event) override {
+        TraceEvent& slot = buffer[recorded++ % buffer.size()];
+        slot = event;
+        slot.block = block;
+    }
+
+    /**
+     * @brief Returns the events kept, oldest first.
+     */
+    vector<TraceEvent> events() const {
+        size_t kept = (size_t)min<uint64_t>(recorded, buffer.size());
+        vector<TraceEvent> result;
+        result.reserve(kept);
+        for(uint64_t i = recorded - kept; i < recorded; i++) result.push_back(buffer[i % buffer.size()]);
+        return result;
+    }
+
+    /**
+     * @brief Returns the number of blocks offered to the sink (sampled or not).
+     */
+    uint64_t offered() const {
+        return blocks;
+    }
+
+    /**
+     * @brief Returns the number of events recorded since the last clear, including overwritten ones.
+     */
+    uint64_t total() const {
+        return recorded;
+    }
+
+    /**
+     * @brief Drops the events kept and restarts the block count.
+     */
+    void clear() {
+        blocks = recorded = block = 0;
+    }
+
+private:
+
+    vector<TraceEvent> buffer;
+    uint64_t period;
+    uint64_t blocks = 0;    // Blocks offered so far
+    uint64_t recorded = 0;  // Events recorded so far
+    uint64_t block = 0;     // Index of the block being traced
+};
+
+/**
+ * @class TextTraceSink
+ * @brief Formats the events as the step-by-step text of the interactive debug mode.
+ *
+ * @details Used as a sink, every block is traced and printed as it runs. format() replays
+ * recorded events (e.g. from a RingTraceSink) through the same formatter, with a header line
+ * per block.
+ */
+class TextTraceSink : public TraceSink {
+public:
+
+    /**
+     * @brief Constructs a text sink.
+     *
+     * @param out_ The stream written to.
+     * @param block_headers_ Starts each block with a line giving its index, direction, input and key.
+     */
+    TextTraceSink(ostream& out_ = cout, bool block_headers_ = false) : out(out_), block_headers(block_headers_) {}
+
+    bool sample() override {
+        block = blocks++;
+        return true;
+    }
+
+    void record(const TraceEvent& event) override {
+        TraceEvent stamped = event;
+        stamped.block = block;
+        write(stamped);
+    }
+
+    /**
+     * @brief Writes recorded events as text, with a header line per block.
+     */
+    static void format(span<const TraceEvent> events, ostream& out = cout) {
+        TextTraceSink text(out, true);
+        for(const TraceEvent& event : events) text.write(event);
+    }
+
+    /**
+     * @brief Formats a 16-bit state as four space-separated binary nibbles, most significant first.
+     */
+    static string nibbles(uint16_t state) {
+        string text;
+        for(int shift=12; shift >= 0; shift -= 4) text += toBin((state >> shift) & 0xF, 4) + " ";
+        return text;
+    }
+
+private:
+
+    ostream& out;
+    bool block_headers;
+    uint64_t blocks = 0;
+    uint64_t block = 0;
+    uint16_t keys[3] = {};      // Round keys seen so far in the current block
+    bool key_schedule = false;  // Inside a key generation section
+
+    void write(const TraceEvent& event) {
+        switch(event.step){
+            case TraceStep::BEGIN:
+                keys[0] = event.operand;
+                if(block_headers){
+                    char line[96];
+                    snprintf(line, sizeof(line), "====== Block %llu: %s of %04X, key %04X ======\n\n",
+                             (unsigned long long)event.block, event.decrypt ? "decryption" : "encryption",
+                             event.state, event.operand);
+                    out << line;
+                }
+                break;
+            case TraceStep::KEY_SCHEDULE:
+                key_schedule = true;
+                out << "------------- Key Generation --------------\n\n";
+                break;
+            case TraceStep::ROUND:
+                if(key_schedule){
+                    out << "Key0 = " << nibbles(keys[0]) << "\nKey1 = " << nibbles(keys[1])
+                        << "\nKey2 = " << nibbles(keys[2]) << "\n\n";
+                    key_schedule = false;
+                }
+                out << "------------- " << round_title(event) << " --------------\n\n";
+                break;
+            case TraceStep::ADD_ROUND_KEY:
+                out << "Adding round key:\n= " << nibbles(event.state ^ event.operand) << "  XOR  "
+                    << nibbles(event.operand) << "\n= " << nibbles(event.state) << "\n\n";
+                break;
+            case TraceStep::SUB_NIBBLES:
+                out << "Substituting nibbles:\n= " << nibbles(event.state) << "\n\n";
+                break;
+            case TraceStep::SHIFT_ROWS:
+                out << "Shifting rows:\n= " << nibbles(event.state) << "\n\n";
+                break;
+            case TraceStep::MIX_COLUMNS:
+                out << "Mixing Columns:\n= " << nibbles(event.state) << "\n\n";
+                break;
+            case TraceStep::EXPAND_KEY:
+                if(event.round < 3) keys[event.round] = event.state;
+                out << "Expanding Key " << event.round - 1 << " (" << nibbles(event.operand) << "):\nKey "
+                    << (int)event.round << " = " << nibbles(event.state) << "\n\n";
+                break;
+            case TraceStep::END:
+                if(block_headers){
+                    char line[32];
+                    snprintf(line, sizeof(line), "-> %04X\n\n", event.state);
+                    out << line;
+                }
+                break;
+        }
+    }
+
+    static const char* round_title(const TraceEvent& event) {
+        if(event.decrypt) return event.round == 2 ? "Initial Round (2)" : event.round == 1 ? "Round 1" : "Final Round (0)";
+        return event.round == 0 ? "Round 0" : event.round == 1 ? "Round 1" : "Final Round (2)";
+    }
+};
+
+#endif
@@ -1,36 +1,21 @@
+#include <iostream>
 #include <vector>
 #include <string>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+
+#include <unistd.h>
+
+#include "instrument.hpp"
 
 using namespace std;
 
 #ifndef UTILS_HPP
 #define UTILS_HPP
 
-/**
- * @brief Extracts a slice (subvector) from a vector of integers.
- *
- * @param bytes The source vector.
- * @param l The starting index of the slice.
- * @param size The length of the slice.
- * @return A vector containing the slice bytes[l..l+size-1].
- */
-vector<int> get_vector_slice(vector<int> bytes, int l, int size) {
-    auto result = vector<int>(bytes.begin() + l, bytes.begin() + l + size);
-    return result;
-}
-
-/**
- * @brief Converts a string to a vector of bytes (integers).
- *
- * Each character's ASCII value is converted to an integer in the vector.
- *
- * @param str The input string.
- * @return Vector of integer byte values corresponding to the characters.
- */
-vector<int> get_bytes_from_text(string str) {
-    return vector<int>(str.begin(), str.end());
-}
-
 /**
  * @brief Converts an integer to its binary representation as a string of fixed size.
  *
@@ -48,37 +33,6 @@ string toBin(int n, int sz){
     return bits;
 }
 
-/**
- * @brief Converts a 2x2 matrix of 4-bit nibbles into a concatenated binary string.
- *
- * The nibbles are concatenated in column-major order.
- *
- * @param nibble_matrix 2x2 matrix of integers (each 4 bits).
- * @return A binary string of length 16 representing all nibbles.
- */
-string toBin(vector<vector<int>>& nibble_matrix){
-    string bits="";
-    for(int i=0; i < 2; i++){
-        for(int j=0; j < 2; j++){
-            bits += toBin(nibble_matrix[j][i], 4);
-        }
-    }
-    return bits;
-}
-
-/**
- * @brief Prints the 2x2 nibble matrix as binary strings, each nibble separated by space.
- *
- * @param nibble_matrix 2x2 matrix of integers (each 4 bits).
- */
-void print(vector<vector<int>>& nibble_matrix){
-    for(int i=0; i < 2; i++){
-        for(int j=0; j < 2; j++){
-            cout << toBin(nibble_matrix[j][i], 4) << " ";
-        }
-    }
-}
-
 /**
  * @brief Converts a binary string to its integer value.
  *
@@ -114,21 +68,78 @@ int toInt(vector<int>& bits){
     return num;
 }
 
+// Vector loops compiled for AVX-512, AVX2 and baseline x86-64, picked at load time
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SAES_VECTOR_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define SAES_VECTOR_CLONES
+#endif
+
+typedef uint8_t xor_block __attribute__((vector_size(64)));
+
 /**
- * @brief Converts a 16-bit binary string into a vector of two bytes (integers).
+ * @brief XORs two byte buffers: out[i] = in[i] ^ key[i] for i in [0, size).
  *
- * The input string must have length 16.
+ * Works on 64-byte vectors (one AVX-512, two AVX2 or four SSE2 operations each), then on
+ * 64-bit words for the tail. 'out' may alias 'in'.
  *
- * @param bits Binary string of length 16.
- * @return Vector with two integers representing the high and low byte.
+ * @param out Destination buffer.
+ * @param in First operand.
+ * @param key Second operand (typically keystream).
+ * @param size Number of bytes.
  */
-vector<int> fromBinToVectorByte(string bits){
-    int bite1, bite2;
-    bite1 = toInt(bits.substr(0, 8));
-    bite2 = toInt(bits.substr(8, 8));
-    vector<int> ans = {bite1, bite2};
-    return ans;
+SAES_VECTOR_CLONES void xor_bytes(uint8_t* out, const uint8_t* in, const uint8_t* key, size_t size){
+    size_t i = 0;
+    for(; i + sizeof(xor_block) <= size; i += sizeof(xor_block)){
+        xor_block a, b;
+        memcpy(&a, in + i, sizeof(a));
+        memcpy(&b, key + i, sizeof(b));
+        a ^= b;
+        memcpy(out + i, &a, sizeof(a));
+    }
+    for(; i + 8 <= size; i += 8){
+        uint64_t a, b;
+        memcpy(&a, in + i, 8);
+        memcpy(&b, key + i, 8);
+        a ^= b;
+        memcpy(out + i, &a, 8);
+    }
+    for(; i < size; i++) out[i] = in[i] ^ key[i];
 }
 
+/**
+ * @brief Reads from a file descriptor until 'size' bytes are available or the input ends.
+ *
+ * @return The number of bytes read (less than 'size' only at the end of the input).
+ * @throws runtime_error on a read error.
+ */
+size_t read_full(int fd, uint8_t* buffer, size_t size){
+    Instrument::Timer timer(Instrument::IO_READ);
+    size_t done = 0;
+    while(done < size){
+        ssize_t r = ::read(fd, buffer + done, size - done);
+        if(r < 0 && errno == EINTR) continue;
+        if(r < 0) throw runtime_error(string("read failed: ") + strerror(errno));
+        if(r == 0) break;
+        done += (size_t)r;
+    }
+    return done;
+}
+
+/**
+ * @brief Writes all 'size' bytes to a file descriptor (pipes and sockets may take them in parts).
+ *
+ * @throws runtime_error on a write error.
+ */
+void write_full(int fd, const uint8_t* buffer, size_t size){
+    Instrument::Timer timer(Instrument::IO_WRITE);
+    size_t done = 0;
+    while(done < size){
+        ssize_t w = ::write(fd, buffer + done, size - done);
+        if(w < 0 && errno == EINTR) continue;
+        if(w < 0) throw runtime_error(string("write failed: ") + strerror(errno));
+        done += (size_t)w;
+    }
+}
 
 #endif
\ No newline at end of file
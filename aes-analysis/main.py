@@ -1,3 +1,4 @@
+import sys
 import time
 import utils
 from Cryptodome.Cipher import AES
@@ -141,4 +142,12 @@ test_mode(key, message, AES.MODE_ECB)
 test_mode(key, message, AES.MODE_CBC, iv)
 test_mode(key, message, AES.MODE_CFB, iv)
 test_mode(key, message, AES.MODE_OFB, iv)
-test_mode(key, message, AES.MODE_CTR, nonce = nonce)
\ No newline at end of file
+test_mode(key, message, AES.MODE_CTR, nonce = nonce)
+
+# S-AES timings for the same message, from S-AES/bench.cpp --csv FILE or --json FILE
+if len(sys.argv) > 1:
+    print(f"S-AES benchmark ({len(message)} bytes):")
+    for row in load_saes_benchmark(sys.argv[1]):
+        if row['bytes'] == len(message):
+            print(f"{row['engine']} ({row['operation']}): median {row['median_ns']:.0f} ns, "
+                  f"p99 {row['p99_ns']:.0f} ns, {row['mb_per_s']:.1f} MB/s")
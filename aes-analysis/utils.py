@@ -1,5 +1,7 @@
 from Cryptodome.Cipher import AES
 import base64
+import csv
+import json
 
 def get_mode_name(mode):
     if mode == AES.MODE_ECB:
@@ -28,3 +30,20 @@ def hex_to_base64(hex_string):
 def print_bytes(name, hex):
     print(name + ": Hex (" + hex + '), B64 (' + hex_to_base64(hex) + ')')
     return
+
+def load_saes_benchmark(path):
+    # Results written by S-AES/bench.cpp with --csv or --json, one dict per (engine, operation, size)
+    if path.endswith('.json'):
+        with open(path, 'r') as f:
+            return json.load(f)['results']
+
+    with open(path, 'r', newline='') as f:
+        rows = list(csv.DictReader(f))
+
+    for row in rows:
+        for field in row:
+            if field in ('bytes', 'iterations'):
+                row[field] = int(row[field])
+            elif field not in ('engine', 'operation'):
+                row[field] = float(row[field])
+    return rows